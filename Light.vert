@@ -1,11 +1,23 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+#ifdef INSTANCED
+// per-instance model matrix, one column per location 1-4
+layout (location = 1) in mat4 aModel;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aModel;
+#endif
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+// the baseInstance of the draw, set by LightCull.comp to the object index
+layout (location = 1) in uint aObjectId;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+struct Object
+{
+    mat4 model;
+    vec4 bounds;
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint padding;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+void main()
+{
+    gl_Position = projection * view * objects[aObjectId].model * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// The six clip planes of a view-projection matrix (Gribb/Hartmann), normalized
+// so that dot(plane.xyz, p) + plane.w is the signed distance of p, positive inside.
+// Order: left, right, bottom, top, near, far.
+struct Frustum {
+	glm::vec4 planes[6];
+
+	explicit Frustum(const glm::mat4& viewProjection)
+	{
+		// glm is column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+		auto row = [&viewProjection](int i) {
+			return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		};
+		for (int i = 0; i < 3; ++i) {
+			planes[i * 2] = row(3) + row(i);
+			planes[i * 2 + 1] = row(3) - row(i);
+		}
+		for (auto& plane : planes) {
+			float length = glm::length(glm::vec3(plane));
+			if (length > 0.0f) {
+				plane = plane * (1.0f / length);
+			}
+		}
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const auto& plane : planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
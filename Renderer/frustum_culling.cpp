@@ -0,0 +1,281 @@
+#include "frustum_culling.h"
+#include <algorithm>
+#include <cfloat>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CULLING_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts intrinsics of any instruction set without per-function targets
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+// padding spheres: no signed distance reaches -FLT_MAX
+const float PADDING_RADIUS = -FLT_MAX;
+
+// Kernels process [begin, end), both multiples of SphereBounds::BLOCK, and write
+// at most end - begin indices to out. Returns the number written.
+using CullFunction = size_t (*)(const Frustum& frustum, const SphereBounds& bounds, size_t begin, size_t end, uint32_t* out);
+
+size_t cullScalar(const Frustum& frustum, const SphereBounds& bounds, size_t begin, size_t end, uint32_t* out)
+{
+	const float* xs = bounds.x();
+	const float* ys = bounds.y();
+	const float* zs = bounds.z();
+	const float* rs = bounds.radius();
+	size_t count = 0;
+	for (size_t i = begin; i < end; ++i) {
+		bool inside = true;
+		for (const auto& plane : frustum.planes) {
+			inside &= plane.x * xs[i] + plane.y * ys[i] + plane.z * zs[i] + plane.w >= -rs[i];
+		}
+		// store unconditionally, advance only if visible: no branch to mispredict
+		out[count] = static_cast<uint32_t>(i);
+		count += inside;
+	}
+	return count;
+}
+
+#ifdef CULLING_X86
+
+size_t cullSse2(const Frustum& frustum, const SphereBounds& bounds, size_t begin, size_t end, uint32_t* out)
+{
+	__m128 px[6], py[6], pz[6], pw[6];
+	for (int p = 0; p < 6; ++p) {
+		px[p] = _mm_set1_ps(frustum.planes[p].x);
+		py[p] = _mm_set1_ps(frustum.planes[p].y);
+		pz[p] = _mm_set1_ps(frustum.planes[p].z);
+		pw[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	size_t count = 0;
+	for (size_t i = begin; i < end; i += 8) {
+		int mask = 0;
+		for (size_t half = 0; half < 2; ++half) {
+			size_t j = i + half * 4;
+			__m128 x = _mm_loadu_ps(bounds.x() + j);
+			__m128 y = _mm_loadu_ps(bounds.y() + j);
+			__m128 z = _mm_loadu_ps(bounds.z() + j);
+			__m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(bounds.radius() + j), signBit);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+					_mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+			mask |= _mm_movemask_ps(inside) << (half * 4);
+		}
+		for (int bit = 0; bit < 8; ++bit) {
+			out[count] = static_cast<uint32_t>(i + bit);
+			count += (mask >> bit) & 1;
+		}
+	}
+	return count;
+}
+
+TARGET_AVX2
+size_t cullAvx2(const Frustum& frustum, const SphereBounds& bounds, size_t begin, size_t end, uint32_t* out)
+{
+	__m256 px[6], py[6], pz[6], pw[6];
+	for (int p = 0; p < 6; ++p) {
+		px[p] = _mm256_set1_ps(frustum.planes[p].x);
+		py[p] = _mm256_set1_ps(frustum.planes[p].y);
+		pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+		pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	size_t count = 0;
+	for (size_t i = begin; i < end; i += 16) {
+		int mask = 0;
+		for (size_t half = 0; half < 2; ++half) {
+			size_t j = i + half * 8;
+			__m256 x = _mm256_loadu_ps(bounds.x() + j);
+			__m256 y = _mm256_loadu_ps(bounds.y() + j);
+			__m256 z = _mm256_loadu_ps(bounds.z() + j);
+			__m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(bounds.radius() + j), signBit);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p) {
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+					_mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+			mask |= _mm256_movemask_ps(inside) << (half * 8);
+		}
+		for (int bit = 0; bit < 16; ++bit) {
+			out[count] = static_cast<uint32_t>(i + bit);
+			count += (mask >> bit) & 1;
+		}
+	}
+	return count;
+}
+
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	// the OS must save the AVX registers on context switches
+	bool osSavesAvx = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+	return osSavesAvx && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+CullFunction cullFunction(CullKernel kernel)
+{
+	switch (kernel) {
+#ifdef CULLING_X86
+	case CullKernel::SSE2: return &cullSse2;
+	case CullKernel::AVX2: return &cullAvx2;
+#endif
+	default: return &cullScalar;
+	}
+}
+
+}
+
+void SphereBounds::clear()
+{
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+	m_radius.clear();
+	m_size = 0;
+}
+
+void SphereBounds::reserve(size_t count)
+{
+	count = (count + BLOCK - 1) / BLOCK * BLOCK;
+	m_x.reserve(count);
+	m_y.reserve(count);
+	m_z.reserve(count);
+	m_radius.reserve(count);
+}
+
+void SphereBounds::add(const glm::vec3& center, float radius)
+{
+	if (m_size == m_x.size()) {
+		m_x.resize(m_size + BLOCK, 0.0f);
+		m_y.resize(m_size + BLOCK, 0.0f);
+		m_z.resize(m_size + BLOCK, 0.0f);
+		m_radius.resize(m_size + BLOCK, PADDING_RADIUS);
+	}
+	set(m_size++, center, radius);
+}
+
+void SphereBounds::set(size_t index, const glm::vec3& center, float radius)
+{
+	m_x[index] = center.x;
+	m_y[index] = center.y;
+	m_z[index] = center.z;
+	m_radius[index] = radius;
+}
+
+const char* cullKernelName(CullKernel kernel)
+{
+	switch (kernel) {
+	case CullKernel::Scalar: return "scalar";
+	case CullKernel::SSE2: return "sse2";
+	case CullKernel::AVX2: return "avx2";
+	}
+	return "unknown";
+}
+
+bool FrustumCuller::isSupported(CullKernel kernel)
+{
+	switch (kernel) {
+	case CullKernel::Scalar:
+		return true;
+#ifdef CULLING_X86
+	case CullKernel::SSE2:
+		// baseline of every x86-64 CPU
+		return true;
+	case CullKernel::AVX2: {
+		static const bool hasAvx2 = cpuHasAvx2();
+		return hasAvx2;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+CullKernel FrustumCuller::bestKernel()
+{
+	if (isSupported(CullKernel::AVX2)) {
+		return CullKernel::AVX2;
+	}
+	if (isSupported(CullKernel::SSE2)) {
+		return CullKernel::SSE2;
+	}
+	return CullKernel::Scalar;
+}
+
+FrustumCuller::FrustumCuller(CullKernel kernel, unsigned threads)
+{
+	setKernel(kernel);
+	setThreads(threads);
+}
+
+void FrustumCuller::setKernel(CullKernel kernel)
+{
+	m_kernel = isSupported(kernel) ? kernel : CullKernel::Scalar;
+}
+
+void FrustumCuller::setThreads(unsigned threads)
+{
+	m_threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void FrustumCuller::cull(const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible) const
+{
+	auto function = cullFunction(m_kernel);
+	const size_t padded = bounds.paddedSize();
+	visible.resize(padded);
+	if (padded < PARALLEL_THRESHOLD || m_threads < 2) {
+		visible.resize(function(frustum, bounds, 0, padded, visible.data()));
+		return;
+	}
+
+	// every thread fills the slice of visible matching its range, then the slices are packed
+	const size_t blocks = padded / SphereBounds::BLOCK;
+	const size_t threads = std::min<size_t>(m_threads, blocks);
+	std::vector<size_t> begins(threads + 1);
+	for (size_t t = 0; t <= threads; ++t) {
+		begins[t] = blocks * t / threads * SphereBounds::BLOCK;
+	}
+	std::vector<size_t> counts(threads);
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t t = 1; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			counts[t] = function(frustum, bounds, begins[t], begins[t + 1], visible.data() + begins[t]);
+		});
+	}
+	counts[0] = function(frustum, bounds, begins[0], begins[1], visible.data());
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	size_t total = counts[0];
+	for (size_t t = 1; t < threads; ++t) {
+		std::copy(visible.begin() + begins[t], visible.begin() + begins[t] + counts[t], visible.begin() + total);
+		total += counts[t];
+	}
+	visible.resize(total);
+}
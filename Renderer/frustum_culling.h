@@ -0,0 +1,70 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frustum.h"
+
+// Bounding spheres in structure-of-arrays layout, so a SIMD kernel loads the x of 4
+// or 8 spheres with one instruction. The arrays are padded to a multiple of BLOCK
+// with spheres no frustum accepts, so the kernels run without tail loops.
+class SphereBounds {
+public:
+	static const size_t BLOCK = 16;
+
+	void clear();
+	void reserve(size_t count);
+	void add(const glm::vec3& center, float radius);
+	void set(size_t index, const glm::vec3& center, float radius);
+
+	size_t size() const { return m_size; }
+	size_t paddedSize() const { return m_x.size(); }
+	const float* x() const { return m_x.data(); }
+	const float* y() const { return m_y.data(); }
+	const float* z() const { return m_z.data(); }
+	const float* radius() const { return m_radius.data(); }
+
+private:
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<float> m_radius;
+	size_t m_size = 0;
+};
+
+enum class CullKernel {
+	Scalar,
+	SSE2,	// 8 spheres per iteration
+	AVX2,	// 16 spheres per iteration
+};
+
+const char* cullKernelName(CullKernel kernel);
+
+// Tests SphereBounds against the six planes of a Frustum and writes the indices of
+// the spheres that intersect it. The kernel is picked at runtime from what the CPU
+// supports; the SIMD kernels are compiled for their instruction set individually,
+// so the rest of the build keeps its baseline flags. Above PARALLEL_THRESHOLD
+// spheres the range is split across threads.
+class FrustumCuller {
+public:
+	static const size_t PARALLEL_THRESHOLD = 100000;
+
+	static bool isSupported(CullKernel kernel);
+	static CullKernel bestKernel();
+
+	// threads 0 uses every hardware thread.
+	explicit FrustumCuller(CullKernel kernel = bestKernel(), unsigned threads = 0);
+
+	CullKernel kernel() const { return m_kernel; }
+	// Falls back to the scalar kernel if the CPU lacks kernel.
+	void setKernel(CullKernel kernel);
+	unsigned threads() const { return m_threads; }
+	void setThreads(unsigned threads);
+
+	// Replaces visible with the indices of the visible spheres, in increasing order.
+	void cull(const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible) const;
+
+private:
+	CullKernel m_kernel;
+	unsigned m_threads = 1;
+};
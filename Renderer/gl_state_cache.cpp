@@ -0,0 +1,382 @@
+#include "gl_state_cache.h"
+
+namespace {
+
+int bufferTargetIndex(GLenum target)
+{
+	switch (target) {
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_SHADER_STORAGE_BUFFER: return 3;
+	case GL_ATOMIC_COUNTER_BUFFER: return 4;
+	case GL_TRANSFORM_FEEDBACK_BUFFER: return 5;
+	case GL_COPY_READ_BUFFER: return 6;
+	case GL_COPY_WRITE_BUFFER: return 7;
+	case GL_PIXEL_PACK_BUFFER: return 8;
+	case GL_PIXEL_UNPACK_BUFFER: return 9;
+	case GL_DRAW_INDIRECT_BUFFER: return 10;
+	case GL_DISPATCH_INDIRECT_BUFFER: return 11;
+	case GL_TEXTURE_BUFFER: return 12;
+	case GL_QUERY_BUFFER: return 13;
+	default: return -1;
+	}
+}
+
+int indexedTargetIndex(GLenum target)
+{
+	switch (target) {
+	case GL_UNIFORM_BUFFER: return 0;
+	case GL_SHADER_STORAGE_BUFFER: return 1;
+	case GL_ATOMIC_COUNTER_BUFFER: return 2;
+	case GL_TRANSFORM_FEEDBACK_BUFFER: return 3;
+	default: return -1;
+	}
+}
+
+int textureTargetIndex(GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_CUBE_MAP: return 1;
+	case GL_TEXTURE_3D: return 2;
+	case GL_TEXTURE_2D_ARRAY: return 3;
+	case GL_TEXTURE_1D: return 4;
+	case GL_TEXTURE_BUFFER: return 5;
+	case GL_TEXTURE_2D_MULTISAMPLE: return 6;
+	case GL_TEXTURE_CUBE_MAP_ARRAY: return 7;
+	default: return -1;
+	}
+}
+
+int capIndex(GLenum cap)
+{
+	switch (cap) {
+	case GL_DEPTH_TEST: return 0;
+	case GL_BLEND: return 1;
+	case GL_CULL_FACE: return 2;
+	case GL_SCISSOR_TEST: return 3;
+	case GL_STENCIL_TEST: return 4;
+	case GL_POLYGON_OFFSET_FILL: return 5;
+	case GL_MULTISAMPLE: return 6;
+	case GL_FRAMEBUFFER_SRGB: return 7;
+	default: return -1;
+	}
+}
+
+thread_local GLStateCache* t_currentCache = nullptr;
+
+}
+
+GLStateCache::GLStateCache()
+{
+	invalidate();
+}
+
+GLStateCache& GLStateCache::current()
+{
+	if (!t_currentCache) {
+		thread_local GLStateCache defaultCache;
+		t_currentCache = &defaultCache;
+	}
+	return *t_currentCache;
+}
+
+void GLStateCache::makeCurrent(GLStateCache* cache)
+{
+	t_currentCache = cache;
+}
+
+void GLStateCache::invalidate()
+{
+	m_program = UNKNOWN;
+	m_pipeline = UNKNOWN;
+	m_vao = UNKNOWN;
+	for (auto& buffer : m_buffers) {
+		buffer = UNKNOWN;
+	}
+	for (auto& target : m_indexed) {
+		for (auto& binding : target) {
+			binding = { UNKNOWN, 0, 0 };
+		}
+	}
+	m_activeTexture = UNKNOWN;
+	for (auto& unit : m_textures) {
+		for (auto& texture : unit) {
+			texture = UNKNOWN;
+		}
+	}
+	m_drawFramebuffer = UNKNOWN;
+	m_readFramebuffer = UNKNOWN;
+	for (auto& cap : m_caps) {
+		cap = -1;
+	}
+	m_depthFunc = GL_NONE;
+	m_depthMask = -1;
+	m_blendSrc = GL_NONE;
+	m_blendDst = GL_NONE;
+	m_cullFace = GL_NONE;
+	m_viewportKnown = false;
+}
+
+bool GLStateCache::changed(bool isSame)
+{
+	if (isSame) {
+		++m_stats.skipped;
+		return false;
+	}
+	++m_stats.issued;
+	return true;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (changed(m_program == program)) {
+		glUseProgram(program);
+		m_program = program;
+	}
+}
+
+void GLStateCache::bindProgramPipeline(GLuint pipeline)
+{
+	if (changed(m_pipeline == pipeline)) {
+		glBindProgramPipeline(pipeline);
+		m_pipeline = pipeline;
+	}
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+	if (changed(m_vao == vao)) {
+		glBindVertexArray(vao);
+		m_vao = vao;
+		// the element array binding is part of the vertex array object
+		m_buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	auto index = bufferTargetIndex(target);
+	if (index < 0) {
+		++m_stats.issued;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (changed(m_buffers[index] == buffer)) {
+		glBindBuffer(target, buffer);
+		m_buffers[index] = buffer;
+	}
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	auto targetIndex = indexedTargetIndex(target);
+	if (targetIndex < 0 || index >= INDEXED_BINDINGS) {
+		++m_stats.issued;
+		glBindBufferBase(target, index, buffer);
+		forgetBuffer(target);
+		return;
+	}
+	auto& binding = m_indexed[targetIndex][index];
+	// size 0 marks a whole-buffer binding
+	if (changed(binding.buffer == buffer && binding.offset == 0 && binding.size == 0)) {
+		glBindBufferBase(target, index, buffer);
+		binding = { buffer, 0, 0 };
+		// binding an indexed target also changes the generic binding
+		m_buffers[bufferTargetIndex(target)] = buffer;
+	}
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	auto targetIndex = indexedTargetIndex(target);
+	if (targetIndex < 0 || index >= INDEXED_BINDINGS) {
+		++m_stats.issued;
+		glBindBufferRange(target, index, buffer, offset, size);
+		forgetBuffer(target);
+		return;
+	}
+	auto& binding = m_indexed[targetIndex][index];
+	if (changed(binding.buffer == buffer && binding.offset == offset && binding.size == size)) {
+		glBindBufferRange(target, index, buffer, offset, size);
+		binding = { buffer, offset, size };
+		m_buffers[bufferTargetIndex(target)] = buffer;
+	}
+}
+
+void GLStateCache::forgetBuffer(GLenum target)
+{
+	auto index = bufferTargetIndex(target);
+	if (index >= 0) {
+		m_buffers[index] = UNKNOWN;
+	}
+}
+
+void GLStateCache::activeTexture(GLuint unit)
+{
+	if (changed(m_activeTexture == unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		m_activeTexture = unit;
+	}
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	auto targetIndex = textureTargetIndex(target);
+	if (targetIndex < 0 || unit >= TEXTURE_UNITS) {
+		activeTexture(unit);
+		++m_stats.issued;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (changed(m_textures[unit][targetIndex] == texture)) {
+		activeTexture(unit);
+		glBindTexture(target, texture);
+		m_textures[unit][targetIndex] = texture;
+	}
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool drawSame = m_drawFramebuffer == framebuffer;
+	bool readSame = m_readFramebuffer == framebuffer;
+	bool same = target == GL_DRAW_FRAMEBUFFER ? drawSame
+		: target == GL_READ_FRAMEBUFFER ? readSame
+		: drawSame && readSame;
+	if (changed(same)) {
+		glBindFramebuffer(target, framebuffer);
+		if (target != GL_READ_FRAMEBUFFER) {
+			m_drawFramebuffer = framebuffer;
+		}
+		if (target != GL_DRAW_FRAMEBUFFER) {
+			m_readFramebuffer = framebuffer;
+		}
+	}
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled)
+{
+	auto index = capIndex(cap);
+	if (index >= 0 && !changed(m_caps[index] == (enabled ? 1 : 0))) {
+		return;
+	}
+	if (index < 0) {
+		++m_stats.issued;
+	} else {
+		m_caps[index] = enabled ? 1 : 0;
+	}
+	if (enabled) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+	if (changed(m_depthFunc == func)) {
+		glDepthFunc(func);
+		m_depthFunc = func;
+	}
+}
+
+void GLStateCache::depthMask(GLboolean mask)
+{
+	if (changed(m_depthMask == (mask ? 1 : 0))) {
+		glDepthMask(mask);
+		m_depthMask = mask ? 1 : 0;
+	}
+}
+
+void GLStateCache::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+	if (changed(m_blendSrc == sfactor && m_blendDst == dfactor)) {
+		glBlendFunc(sfactor, dfactor);
+		m_blendSrc = sfactor;
+		m_blendDst = dfactor;
+	}
+}
+
+void GLStateCache::cullFace(GLenum mode)
+{
+	if (changed(m_cullFace == mode)) {
+		glCullFace(mode);
+		m_cullFace = mode;
+	}
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	bool same = m_viewportKnown && m_viewport[0] == x && m_viewport[1] == y
+		&& m_viewport[2] == width && m_viewport[3] == height;
+	if (changed(same)) {
+		glViewport(x, y, width, height);
+		m_viewport[0] = x;
+		m_viewport[1] = y;
+		m_viewport[2] = width;
+		m_viewport[3] = height;
+		m_viewportKnown = true;
+	}
+}
+
+void GLStateCache::onDeleteProgram(GLuint program)
+{
+	if (m_program == program) {
+		m_program = UNKNOWN;
+	}
+}
+
+void GLStateCache::onDeleteProgramPipeline(GLuint pipeline)
+{
+	if (m_pipeline == pipeline) {
+		// deleting the bound pipeline reverts the binding to zero
+		m_pipeline = 0;
+	}
+}
+
+void GLStateCache::onDeleteVertexArray(GLuint vao)
+{
+	if (m_vao == vao) {
+		// deleting the bound vertex array reverts the binding to zero
+		m_vao = 0;
+		m_buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+}
+
+void GLStateCache::onDeleteBuffer(GLuint buffer)
+{
+	for (auto& bound : m_buffers) {
+		if (bound == buffer) {
+			bound = 0;
+		}
+	}
+	for (auto& target : m_indexed) {
+		for (auto& binding : target) {
+			if (binding.buffer == buffer) {
+				binding = { 0, 0, 0 };
+			}
+		}
+	}
+}
+
+void GLStateCache::onDeleteTexture(GLuint texture)
+{
+	for (auto& unit : m_textures) {
+		for (auto& bound : unit) {
+			if (bound == texture) {
+				bound = 0;
+			}
+		}
+	}
+}
+
+void GLStateCache::onDeleteFramebuffer(GLuint framebuffer)
+{
+	if (m_drawFramebuffer == framebuffer) {
+		m_drawFramebuffer = 0;
+	}
+	if (m_readFramebuffer == framebuffer) {
+		m_readFramebuffer = 0;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+struct GLStateStats {
+	uint64_t issued = 0;	// GL calls forwarded to the driver
+	uint64_t skipped = 0;	// calls dropped because the state was already set
+};
+
+// Shadow of the binding and fixed-function state of one GL context. Renderer code
+// changes state through the cache, which drops calls that would not change
+// anything. Code that touches GL state directly must call invalidate() afterwards.
+class GLStateCache {
+public:
+	GLStateCache();
+
+	// Cache of the context current on the calling thread. Each thread starts with its
+	// own instance; call makeCurrent() alongside switching GL contexts.
+	static GLStateCache& current();
+	static void makeCurrent(GLStateCache* cache);
+
+	void invalidate();
+
+	void useProgram(GLuint program);
+	// Only takes effect while no program is in use.
+	void bindProgramPipeline(GLuint pipeline);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+	void setEnabled(GLenum cap, bool enabled);
+	void enable(GLenum cap) { setEnabled(cap, true); }
+	void disable(GLenum cap) { setEnabled(cap, false); }
+	void depthFunc(GLenum func);
+	void depthMask(GLboolean mask);
+	void blendFunc(GLenum sfactor, GLenum dfactor);
+	void cullFace(GLenum mode);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Forget deleted objects so a recycled name is bound again.
+	void onDeleteProgram(GLuint program);
+	void onDeleteProgramPipeline(GLuint pipeline);
+	void onDeleteVertexArray(GLuint vao);
+	void onDeleteBuffer(GLuint buffer);
+	void onDeleteTexture(GLuint texture);
+	void onDeleteFramebuffer(GLuint framebuffer);
+
+	GLuint program() const { return m_program; }
+	GLuint programPipeline() const { return m_pipeline; }
+	GLuint vertexArray() const { return m_vao; }
+
+	const GLStateStats& stats() const { return m_stats; }
+	void resetStats() { m_stats = GLStateStats(); }
+
+private:
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	static const int BUFFER_TARGETS = 14;
+	static const int INDEXED_TARGETS = 4;
+	static const int INDEXED_BINDINGS = 16;
+	static const int TEXTURE_UNITS = 32;
+	static const int TEXTURE_TARGETS = 8;
+	static const int CAPS = 8;
+
+	struct IndexedBinding {
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	bool changed(bool isSame);
+	void forgetBuffer(GLenum target);
+	void activeTexture(GLuint unit);
+
+private:
+	GLuint m_program;
+	GLuint m_pipeline;
+	GLuint m_vao;
+	GLuint m_buffers[BUFFER_TARGETS];
+	IndexedBinding m_indexed[INDEXED_TARGETS][INDEXED_BINDINGS];
+	GLuint m_activeTexture;
+	GLuint m_textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+	GLuint m_drawFramebuffer;
+	GLuint m_readFramebuffer;
+	int8_t m_caps[CAPS];	// -1 unknown, 0 disabled, 1 enabled
+	GLenum m_depthFunc;
+	int8_t m_depthMask;
+	GLenum m_blendSrc;
+	GLenum m_blendDst;
+	GLenum m_cullFace;
+	GLint m_viewport[4];
+	bool m_viewportKnown;
+	GLStateStats m_stats;
+};
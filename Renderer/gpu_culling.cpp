@@ -0,0 +1,140 @@
+#include "gpu_culling.h"
+#include <cstdio>
+#include <numeric>
+#include "frustum.h"
+#include "gl_state_cache.h"
+
+namespace {
+
+void deleteBuffer(GLuint& buffer)
+{
+	if (buffer) {
+		glDeleteBuffers(1, &buffer);
+		GLStateCache::current().onDeleteBuffer(buffer);
+		buffer = 0;
+	}
+}
+
+}
+
+GpuCuller::~GpuCuller()
+{
+	deleteBuffer(m_objects);
+	deleteBuffer(m_commands);
+	deleteBuffer(m_drawCount);
+	deleteBuffer(m_objectIds);
+}
+
+bool GpuCuller::isSupported()
+{
+	return GLAD_GL_VERSION_4_3;
+}
+
+bool GpuCuller::hasIndirectCount()
+{
+	return GLAD_GL_VERSION_4_6;
+}
+
+bool GpuCuller::init(const std::string& cullShaderFile, std::string* log)
+{
+	if (!m_cullShader.attachShaderFile(GL_COMPUTE_SHADER, cullShaderFile, log)
+		|| !m_cullShader.compile(log)) {
+		return false;
+	}
+	auto& state = GLStateCache::current();
+	glGenBuffers(1, &m_drawCount);
+	state.bindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCount);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+	return true;
+}
+
+void GpuCuller::setObjects(const std::vector<GpuObject>& objects)
+{
+	auto& state = GLStateCache::current();
+	m_count = static_cast<uint32_t>(objects.size());
+	if (!m_objects) {
+		glGenBuffers(1, &m_objects);
+		glGenBuffers(1, &m_commands);
+		glGenBuffers(1, &m_objectIds);
+	}
+	state.bindBuffer(GL_SHADER_STORAGE_BUFFER, m_objects);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(GpuObject), objects.data(), GL_STATIC_DRAW);
+	// written by the cull shader only
+	state.bindBuffer(GL_SHADER_STORAGE_BUFFER, m_commands);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+
+	std::vector<GLuint> ids(objects.size());
+	std::iota(ids.begin(), ids.end(), 0u);
+	state.bindBuffer(GL_ARRAY_BUFFER, m_objectIds);
+	glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+}
+
+void GpuCuller::bindObjectIds(GLuint vertexArray, GLuint location)
+{
+	auto& state = GLStateCache::current();
+	state.bindVertexArray(vertexArray);
+	state.bindBuffer(GL_ARRAY_BUFFER, m_objectIds);
+	glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glEnableVertexAttribArray(location);
+	// instanced attributes start at baseInstance, so every command reads its own object index
+	glVertexAttribDivisor(location, 1);
+}
+
+void GpuCuller::cull(const glm::mat4& viewProjection)
+{
+	if (!m_count) {
+		return;
+	}
+	auto& state = GLStateCache::current();
+	const GLuint zero = 0;
+	state.bindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCount);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (!hasIndirectCount()) {
+		state.bindBuffer(GL_SHADER_STORAGE_BUFFER, m_commands);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, m_objects);
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_commands);
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, m_drawCount);
+
+	Frustum frustum(viewProjection);
+	m_cullShader.setUniform("frustumPlanes", frustum.planes, 6);
+	m_cullShader.setUniform("objectCount", static_cast<GLuint>(m_count));
+	m_cullShader.flush();
+	m_cullShader.use();
+	glDispatchCompute((m_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+	// the commands are read as indirect arguments, the objects again by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuCuller::draw(GLenum mode, GLenum indexType)
+{
+	if (!m_count) {
+		return;
+	}
+	auto& state = GLStateCache::current();
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, m_objects);
+	state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands);
+	if (hasIndirectCount()) {
+		state.bindBuffer(GL_PARAMETER_BUFFER, m_drawCount);
+		glMultiDrawElementsIndirectCount(mode, indexType, nullptr, 0, static_cast<GLsizei>(m_count), 0);
+	} else {
+		glMultiDrawElementsIndirect(mode, indexType, nullptr, static_cast<GLsizei>(m_count), 0);
+	}
+}
+
+uint32_t GpuCuller::readVisibleCount()
+{
+	GLuint count = 0;
+	if (m_drawCount) {
+		GLStateCache::current().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCount);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+	}
+	return count;
+}
+
+void GpuCuller::printStats()
+{
+	printf("gpu culling: %u of %u objects drawn in the last frame, %s\n",
+		readVisibleCount(), m_count, hasIndirectCount() ? "glMultiDrawElementsIndirectCount" : "glMultiDrawElementsIndirect");
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "shader.h"
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "indirect commands are five tightly packed integers");
+
+// std430 layout of the Object struct shared by the cull and vertex shaders.
+struct GpuObject {
+	glm::mat4 model;
+	glm::vec4 bounds;	// world-space bounding sphere: center xyz, radius w
+	GLuint indexCount = 0;	// the mesh range drawn for the object
+	GLuint firstIndex = 0;
+	GLint baseVertex = 0;
+	GLuint padding = 0;
+};
+static_assert(sizeof(GpuObject) == 96, "GpuObject must match the std430 Object struct");
+
+// Frustum culling and draw submission on the GPU (GL 4.3). Objects live in a shader
+// storage buffer; cull() runs a compute shader that tests their bounding spheres
+// against the frustum and appends one DrawElementsIndirectCommand per visible object,
+// counting them with an atomic. draw() consumes the commands with a single
+// glMultiDrawElementsIndirectCount (GL 4.6), which reads the count on the GPU, or
+// with glMultiDrawElementsIndirect over every slot, the command buffer then being
+// cleared before each cull so the slots past the count draw nothing.
+// Each command draws one instance whose baseInstance is the object index. An
+// attribute with divisor 1 over an identity buffer (bindObjectIds()) hands it to the
+// vertex shader, which reads the object from the same buffer; this needs no
+// gl_DrawID, which would require GL 4.6.
+class GpuCuller {
+public:
+	// shader storage bindings used by the cull shader; the vertex shader reads OBJECTS
+	static const GLuint OBJECT_BINDING = 0;
+	static const GLuint COMMAND_BINDING = 1;
+	static const GLuint COUNT_BINDING = 2;
+	static const GLuint WORKGROUP_SIZE = 64;	// local_size_x of the cull shader
+
+	static bool isSupported();
+	static bool hasIndirectCount();
+
+	GpuCuller() = default;
+	~GpuCuller();
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	bool init(const std::string& cullShaderFile, std::string* log = nullptr);
+	void setObjects(const std::vector<GpuObject>& objects);
+	// Feeds the object index to attribute location of vertexArray as a uint.
+	void bindObjectIds(GLuint vertexArray, GLuint location);
+
+	void cull(const glm::mat4& viewProjection);
+	// Draws with the program, vertex array and element buffer currently bound.
+	void draw(GLenum mode, GLenum indexType);
+
+	Shader& cullShader() { return m_cullShader; }
+	uint32_t objectCount() const { return m_count; }
+	// Count written by the last cull(); waits for the GPU.
+	uint32_t readVisibleCount();
+	void printStats();
+
+private:
+	Shader m_cullShader;
+	GLuint m_objects = 0;
+	GLuint m_commands = 0;
+	GLuint m_drawCount = 0;
+	GLuint m_objectIds = 0;
+	uint32_t m_count = 0;
+};
@@ -0,0 +1,170 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+double GpuZone::averageMs() const
+{
+	if (history.empty()) {
+		return 0.0;
+	}
+	double sum = 0.0;
+	for (auto value : history) {
+		sum += value;
+	}
+	return sum / history.size();
+}
+
+double GpuZone::maxMs() const
+{
+	return history.empty() ? 0.0 : *std::max_element(history.begin(), history.end());
+}
+
+GpuProfiler::GpuProfiler(uint32_t frames, size_t historySize)
+	:m_frames(std::max<uint32_t>(frames, 2))
+	,m_historySize(std::max<size_t>(historySize, 1))
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto& frame : m_frames) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		}
+	}
+}
+
+void GpuProfiler::beginFrame()
+{
+	// collect in submission order; stop at the first frame still in flight
+	while (m_nextToCollect < m_frameCount) {
+		auto& frame = m_frames[m_nextToCollect % m_frames.size()];
+		if (frame.pending && !collect(frame)) {
+			break;
+		}
+		++m_nextToCollect;
+	}
+
+	m_current = static_cast<uint32_t>(m_frameCount % m_frames.size());
+	auto& frame = m_frames[m_current];
+	m_recording = !frame.pending;
+	if (!m_recording) {
+		++m_skippedFrames;
+		return;
+	}
+	frame.records.clear();
+	frame.used = 0;
+}
+
+void GpuProfiler::endFrame()
+{
+	if (m_recording) {
+		auto& frame = m_frames[m_current];
+		frame.pending = !frame.records.empty();
+		m_recording = false;
+		++m_frameCount;
+	}
+}
+
+uint32_t GpuProfiler::allocateQuery(Frame& frame)
+{
+	if (frame.used == frame.queries.size()) {
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+	return frame.used++;
+}
+
+int GpuProfiler::beginZone(const std::string& name)
+{
+	if (!m_recording) {
+		return -1;
+	}
+	auto it = m_zoneIndices.find(name);
+	if (it == m_zoneIndices.end()) {
+		GpuZone zone;
+		zone.name = name;
+		zone.history.reserve(m_historySize);
+		it = m_zoneIndices.emplace(name, static_cast<uint32_t>(m_zones.size())).first;
+		m_zones.push_back(std::move(zone));
+	}
+	auto& frame = m_frames[m_current];
+	Record record;
+	record.zone = it->second;
+	record.begin = allocateQuery(frame);
+	record.end = record.begin;
+	glQueryCounter(frame.queries[record.begin], GL_TIMESTAMP);
+	frame.records.push_back(record);
+	return static_cast<int>(frame.records.size() - 1);
+}
+
+void GpuProfiler::endZone(int zone)
+{
+	if (!m_recording || zone < 0) {
+		return;
+	}
+	auto& frame = m_frames[m_current];
+	auto& record = frame.records[zone];
+	record.end = allocateQuery(frame);
+	glQueryCounter(frame.queries[record.end], GL_TIMESTAMP);
+}
+
+bool GpuProfiler::collect(Frame& frame)
+{
+	for (uint32_t i = 0; i < frame.used; ++i) {
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return false;
+		}
+	}
+	m_frameTotals.assign(m_zones.size(), -1.0);
+	for (const auto& record : frame.records) {
+		if (record.end == record.begin) {
+			// zone never ended
+			continue;
+		}
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(frame.queries[record.begin], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[record.end], GL_QUERY_RESULT, &end);
+		auto& total = m_frameTotals[record.zone];
+		total = std::max(total, 0.0) + (end > begin ? (end - begin) / 1.0e6 : 0.0);
+	}
+	for (size_t i = 0; i < m_zones.size(); ++i) {
+		if (m_frameTotals[i] < 0.0) {
+			continue;
+		}
+		auto& zone = m_zones[i];
+		if (zone.history.size() < m_historySize) {
+			zone.history.push_back(m_frameTotals[i]);
+		} else {
+			zone.history[zone.next] = m_frameTotals[i];
+		}
+		zone.next = (zone.next + 1) % m_historySize;
+		zone.latestMs = m_frameTotals[i];
+		++zone.samples;
+	}
+	frame.pending = false;
+	return true;
+}
+
+const GpuZone* GpuProfiler::find(const std::string& name) const
+{
+	auto it = m_zoneIndices.find(name);
+	return it == m_zoneIndices.end() ? nullptr : &m_zones[it->second];
+}
+
+void GpuProfiler::printReport() const
+{
+	for (const auto& zone : m_zones) {
+		printf("gpu zone %s: %.3f ms avg, %.3f ms max over the last %u frames (%llu samples)\n",
+			zone.name.c_str(), zone.averageMs(), zone.maxMs(),
+			static_cast<unsigned>(zone.history.size()), static_cast<unsigned long long>(zone.samples));
+	}
+	if (m_skippedFrames) {
+		printf("gpu profiler: %llu frames skipped while the query ring was full\n",
+			static_cast<unsigned long long>(m_skippedFrames));
+	}
+}
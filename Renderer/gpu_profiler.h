@@ -0,0 +1,90 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Rolling GPU time of one named zone, summed over the zone's uses in a frame.
+struct GpuZone {
+	std::string name;
+	std::vector<double> history;	// milliseconds, ring of the last historySize frames
+	size_t next = 0;
+	uint64_t samples = 0;
+	double latestMs = 0.0;
+
+	double averageMs() const;
+	double maxMs() const;
+};
+
+// GPU timing of named, nestable zones without pipeline stalls. Each zone is
+// bracketed by two GL_TIMESTAMP queries; the queries of a frame are kept in a ring
+// of N frames and read back only once GL_QUERY_RESULT_AVAILABLE reports them done,
+// typically N-1 frames later. If the GPU falls so far behind that the ring is full,
+// the frame is not recorded rather than waiting.
+class GpuProfiler {
+public:
+	class Scope {
+	public:
+		Scope(GpuProfiler& profiler, const std::string& name)
+			:m_profiler(profiler)
+			,m_zone(profiler.beginZone(name))
+		{
+		}
+		~Scope() { m_profiler.endZone(m_zone); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& m_profiler;
+		int m_zone;
+	};
+
+	explicit GpuProfiler(uint32_t frames = 4, size_t historySize = 120);
+	~GpuProfiler();
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Collects finished frames and starts recording a new one.
+	void beginFrame();
+	void endFrame();
+
+	// Returns a token for endZone(), -1 when the frame is not recorded.
+	int beginZone(const std::string& name);
+	void endZone(int zone);
+
+	const std::vector<GpuZone>& zones() const { return m_zones; }
+	const GpuZone* find(const std::string& name) const;
+	uint64_t skippedFrames() const { return m_skippedFrames; }
+	void printReport() const;
+
+private:
+	struct Record {
+		uint32_t zone;
+		uint32_t begin;	// query indices in the frame's pool
+		uint32_t end;
+	};
+
+	struct Frame {
+		std::vector<GLuint> queries;
+		std::vector<Record> records;
+		uint32_t used = 0;
+		bool pending = false;
+	};
+
+	uint32_t allocateQuery(Frame& frame);
+	bool collect(Frame& frame);
+
+private:
+	std::vector<Frame> m_frames;
+	std::vector<GpuZone> m_zones;
+	std::unordered_map<std::string, uint32_t> m_zoneIndices;
+	std::vector<double> m_frameTotals;	// per zone, while collecting a frame
+	size_t m_historySize;
+	uint32_t m_current = 0;
+	uint64_t m_frameCount = 0;
+	uint64_t m_skippedFrames = 0;
+	// frames are collected in submission order, so zone histories stay ordered
+	uint64_t m_nextToCollect = 0;
+	bool m_recording = false;
+};
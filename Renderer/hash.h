@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. constexpr so that string literals can be hashed at compile time.
+constexpr uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV1A_PRIME = 1099511628211ull;
+
+constexpr uint64_t fnv1a(const char* data, size_t length, uint64_t seed = FNV1A_OFFSET_BASIS)
+{
+	uint64_t hash = seed;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= FNV1A_PRIME;
+	}
+	return hash;
+}
+
+inline uint64_t fnv1a(const std::string& str, uint64_t seed = FNV1A_OFFSET_BASIS)
+{
+	return fnv1a(str.data(), str.size(), seed);
+}
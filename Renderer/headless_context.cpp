@@ -0,0 +1,210 @@
+#include "headless_context.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef RENDERER_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+
+void reportError(std::string* log, const std::string& message)
+{
+	if (log) {
+		*log = message;
+	} else {
+		std::cout << message << "\n";
+	}
+}
+
+#ifdef RENDERER_HAS_EGL
+bool hasExtension(const char* extensions, const char* name)
+{
+	if (!extensions) {
+		return false;
+	}
+	auto length = strlen(name);
+	for (auto it = strstr(extensions, name); it; it = strstr(it + length, name)) {
+		bool start = it == extensions || it[-1] == ' ';
+		bool end = it[length] == ' ' || it[length] == '\0';
+		if (start && end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+EGLDisplay openDisplay()
+{
+	auto clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+			eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay) {
+			auto display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY) {
+				return display;
+			}
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+#endif
+
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	destroy();
+}
+
+bool HeadlessContext::isAvailable()
+{
+#ifdef RENDERER_HAS_EGL
+	return true;
+#else
+	return false;
+#endif
+}
+
+void* HeadlessContext::procAddress(const char* name)
+{
+#ifdef RENDERER_HAS_EGL
+	return reinterpret_cast<void*>(eglGetProcAddress(name));
+#else
+	(void)name;
+	return nullptr;
+#endif
+}
+
+#ifdef RENDERER_HAS_EGL
+bool HeadlessContext::create(int major, int minor, std::string* log, const HeadlessContext* share)
+{
+	destroy();
+	EGLDisplay display;
+	if (share) {
+		display = share->m_display;
+	} else {
+		display = openDisplay();
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+			reportError(log, "no EGL display !");
+			return false;
+		}
+		m_ownsDisplay = true;
+	}
+	m_display = display;
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		reportError(log, "EGL has no desktop OpenGL !");
+		destroy();
+		return false;
+	}
+
+	bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+	if (share) {
+		m_config = share->m_config;
+	} else {
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_ALPHA_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_NONE
+		};
+		EGLConfig config = nullptr;
+		EGLint count = 0;
+		if (!eglChooseConfig(display, configAttribs, &config, 1, &count) || count == 0) {
+			reportError(log, "no matching EGL config !");
+			destroy();
+			return false;
+		}
+		m_config = config;
+	}
+
+	// EGL 1.5 names; identical values in EGL_KHR_create_context
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	m_context = eglCreateContext(display, m_config, share ? share->m_context : EGL_NO_CONTEXT, contextAttribs);
+	if (m_context == EGL_NO_CONTEXT) {
+		m_context = nullptr;
+		reportError(log, "create EGL context failed !");
+		destroy();
+		return false;
+	}
+	if (!surfaceless) {
+		const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		m_surface = eglCreatePbufferSurface(display, m_config, pbufferAttribs);
+		if (m_surface == EGL_NO_SURFACE) {
+			m_surface = nullptr;
+			reportError(log, "create EGL pbuffer failed !");
+			destroy();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool HeadlessContext::makeCurrent()
+{
+	// the bound API is per thread; other threads start out with OpenGL ES
+	auto surface = m_surface ? m_surface : EGL_NO_SURFACE;
+	return m_context && eglBindAPI(EGL_OPENGL_API) && eglMakeCurrent(m_display, surface, surface, m_context);
+}
+
+void HeadlessContext::doneCurrent()
+{
+	// releases the context of the bound API only
+	if (m_display && eglBindAPI(EGL_OPENGL_API)) {
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+}
+
+void HeadlessContext::destroy()
+{
+	if (m_display) {
+		if (eglGetCurrentContext() == m_context) {
+			doneCurrent();
+		}
+		if (m_surface) {
+			eglDestroySurface(m_display, m_surface);
+		}
+		if (m_context) {
+			eglDestroyContext(m_display, m_context);
+		}
+		if (m_ownsDisplay) {
+			eglTerminate(m_display);
+		}
+	}
+	m_display = nullptr;
+	m_config = nullptr;
+	m_context = nullptr;
+	m_surface = nullptr;
+	m_ownsDisplay = false;
+}
+#else
+bool HeadlessContext::create(int, int, std::string* log, const HeadlessContext*)
+{
+	reportError(log, "built without EGL, headless mode unavailable !");
+	return false;
+}
+
+bool HeadlessContext::makeCurrent()
+{
+	return false;
+}
+
+void HeadlessContext::doneCurrent()
+{
+}
+
+void HeadlessContext::destroy()
+{
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+
+// OpenGL core context without a window system, for machines with no display such
+// as CI and benchmark boxes. Created through EGL: the Mesa surfaceless platform is
+// preferred, EGL_KHR_surfaceless_context avoids a drawable, and a 1x1 pbuffer is
+// the fallback. Works with Mesa llvmpipe. Render into a RenderTarget.
+// Only available when built with EGL (RENDERER_HAS_EGL).
+class HeadlessContext {
+public:
+	HeadlessContext() = default;
+	~HeadlessContext();
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	static bool isAvailable();
+	// Function loader for gladLoadGLLoader.
+	static void* procAddress(const char* name);
+
+	// With share, the new context shares objects with it (e.g. for ShaderReloader).
+	bool create(int major, int minor, std::string* log = nullptr, const HeadlessContext* share = nullptr);
+	// Binds the context to the calling thread.
+	bool makeCurrent();
+	void doneCurrent();
+
+	bool isValid() const { return m_context != nullptr; }
+	bool isSurfaceless() const { return m_surface == nullptr; }
+
+private:
+	void destroy();
+
+private:
+	void* m_display = nullptr;
+	void* m_config = nullptr;
+	void* m_context = nullptr;
+	void* m_surface = nullptr;
+	bool m_ownsDisplay = false;
+};
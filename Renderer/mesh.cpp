@@ -0,0 +1,226 @@
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include "hash.h"
+
+namespace {
+
+// LRU cache modelled by the optimizer; larger than any real FIFO so the ordering
+// suits every hardware cache size
+const int OPTIMIZER_CACHE_SIZE = 32;
+
+// Forsyth's vertex score: recently used vertices score high, the vertices of the
+// last triangle slightly less so strips do not win over fans, and vertices with few
+// triangles left score higher so they are finished and leave the cache early.
+float vertexScore(int cachePosition, uint32_t remaining)
+{
+	if (remaining == 0) {
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			score = 0.75f;
+		} else {
+			float scale = 1.0f / (OPTIMIZER_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+	return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+}
+
+}
+
+Mesh Mesh::fromTriangles(const float* vertices, size_t vertexCount, uint32_t components)
+{
+	Mesh mesh;
+	mesh.m_components = components;
+	vertexCount -= vertexCount % 3;
+	const size_t vertexSize = components * sizeof(float);
+
+	// weld: the map stores input vertex numbers and compares the vertex data behind them
+	auto hashVertex = [vertices, components, vertexSize](size_t i) {
+		return static_cast<size_t>(fnv1a(reinterpret_cast<const char*>(vertices + i * components), vertexSize));
+	};
+	auto equalVertex = [vertices, components, vertexSize](size_t a, size_t b) {
+		return !memcmp(vertices + a * components, vertices + b * components, vertexSize);
+	};
+	std::unordered_map<size_t, uint32_t, decltype(hashVertex), decltype(equalVertex)> welded(vertexCount, hashVertex, equalVertex);
+	mesh.m_indices.reserve(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		auto result = welded.emplace(i, static_cast<uint32_t>(welded.size()));
+		if (result.second) {
+			mesh.m_vertices.insert(mesh.m_vertices.end(), vertices + i * components, vertices + (i + 1) * components);
+		}
+		mesh.m_indices.push_back(result.first->second);
+	}
+
+	mesh.m_stats.inputVertices = static_cast<uint32_t>(vertexCount);
+	mesh.m_stats.vertices = mesh.vertexCount();
+	mesh.m_stats.triangles = static_cast<uint32_t>(vertexCount / 3);
+	mesh.m_stats.acmrBefore = acmr(mesh.m_indices, mesh.vertexCount());
+
+	optimizeVertexCache(mesh.m_indices, mesh.vertexCount());
+	optimizeVertexFetch(mesh.m_vertices, components, mesh.m_indices);
+	mesh.m_stats.acmrAfter = acmr(mesh.m_indices, mesh.vertexCount());
+
+	if (mesh.vertexCount() <= std::numeric_limits<uint16_t>::max() + 1u) {
+		mesh.m_shortIndices.assign(mesh.m_indices.begin(), mesh.m_indices.end());
+	}
+	return mesh;
+}
+
+const void* Mesh::indexData() const
+{
+	if (indexType() == GL_UNSIGNED_SHORT) {
+		return m_shortIndices.data();
+	}
+	return m_indices.data();
+}
+
+size_t Mesh::indexDataSize() const
+{
+	return m_indices.size() * (indexType() == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+void Mesh::printStats() const
+{
+	printf("mesh: %u triangles, %u -> %u vertices, %u-bit indices, ACMR %.3f -> %.3f\n",
+		m_stats.triangles, m_stats.inputVertices, m_stats.vertices,
+		indexType() == GL_UNSIGNED_SHORT ? 16u : 32u, m_stats.acmrBefore, m_stats.acmrAfter);
+}
+
+double Mesh::acmr(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	if (indices.size() < 3) {
+		return 0.0;
+	}
+	// a vertex is still cached while fewer than cacheSize misses followed its own
+	std::vector<uint64_t> cachedAt(vertexCount, 0);
+	uint64_t misses = 0;
+	for (auto index : indices) {
+		if (!cachedAt[index] || misses - cachedAt[index] + 1 > cacheSize) {
+			++misses;
+			cachedAt[index] = misses;
+		}
+	}
+	return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+void Mesh::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) {
+		return;
+	}
+
+	// triangles of each vertex; the not yet emitted ones are kept in front
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i) {
+		++remaining[indices[i]];
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i) {
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	int best = 0;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[best]) {
+			best = static_cast<int>(t);
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	size_t scan = 0;
+	while (result.size() < triangleCount * 3) {
+		if (best < 0) {
+			// nothing left around the cache; continue with the next unemitted triangle
+			while (emitted[scan]) {
+				++scan;
+			}
+			best = static_cast<int>(scan);
+		}
+		const uint32_t* triangle = &indices[best * 3];
+		emitted[best] = true;
+		nextCache.assign(triangle, triangle + 3);
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = triangle[k];
+			result.push_back(v);
+			auto begin = adjacency.begin() + offsets[v];
+			auto end = begin + remaining[v];
+			std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end - 1);
+			--remaining[v];
+		}
+		for (auto v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				nextCache.push_back(v);
+			}
+		}
+
+		// rescore every vertex that moved in or fell out of the cache, then their triangles
+		for (size_t i = 0; i < nextCache.size(); ++i) {
+			auto v = nextCache[i];
+			cachePosition[v] = i < OPTIMIZER_CACHE_SIZE ? static_cast<int>(i) : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (auto v : nextCache) {
+			for (uint32_t i = 0; i < remaining[v]; ++i) {
+				auto t = adjacency[offsets[v] + i];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (cachePosition[v] >= 0 && triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = static_cast<int>(t);
+				}
+			}
+		}
+		if (nextCache.size() > OPTIMIZER_CACHE_SIZE) {
+			nextCache.resize(OPTIMIZER_CACHE_SIZE);
+		}
+		cache.swap(nextCache);
+	}
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void Mesh::optimizeVertexFetch(std::vector<float>& vertices, uint32_t components, std::vector<uint32_t>& indices)
+{
+	const uint32_t unused = std::numeric_limits<uint32_t>::max();
+	const size_t vertexCount = components ? vertices.size() / components : 0;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	std::vector<float> reordered;
+	reordered.reserve(vertices.size());
+	uint32_t next = 0;
+	for (auto& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = next++;
+			reordered.insert(reordered.end(), vertices.begin() + index * components, vertices.begin() + (index + 1) * components);
+		}
+		index = remap[index];
+	}
+	// vertices no triangle refers to are dropped
+	vertices.swap(reordered);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+struct MeshStats {
+	uint32_t inputVertices = 0;
+	uint32_t vertices = 0;
+	uint32_t triangles = 0;
+	double acmrBefore = 0.0;	// welded, in input triangle order
+	double acmrAfter = 0.0;
+};
+
+// Indexed triangle mesh built from a non-indexed triangle list of interleaved float
+// vertices. Building welds bitwise identical vertices, orders the triangles for the
+// post-transform vertex cache, then renumbers the vertices in order of first use
+// so fetches walk the vertex buffer forward. Indices are 16-bit when every vertex
+// can be addressed with them.
+class Mesh {
+public:
+	// vertices holds vertexCount vertices of components floats each, three per triangle.
+	static Mesh fromTriangles(const float* vertices, size_t vertexCount, uint32_t components);
+
+	const std::vector<float>& vertices() const { return m_vertices; }
+	uint32_t vertexCount() const { return m_components ? static_cast<uint32_t>(m_vertices.size() / m_components) : 0; }
+	uint32_t components() const { return m_components; }
+	GLsizei stride() const { return static_cast<GLsizei>(m_components * sizeof(float)); }
+
+	GLsizei indexCount() const { return static_cast<GLsizei>(m_indices.size()); }
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, matching indexData().
+	GLenum indexType() const { return m_shortIndices.empty() && !m_indices.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT; }
+	const void* indexData() const;
+	size_t indexDataSize() const;
+	const std::vector<uint32_t>& indices() const { return m_indices; }
+
+	const MeshStats& stats() const { return m_stats; }
+	void printStats() const;
+
+	// Average cache miss ratio: vertex shader invocations per triangle through a FIFO
+	// post-transform cache of cacheSize entries. 3 means no reuse at all.
+	static double acmr(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = 16);
+	// Reorders triangles with Forsyth's linear-speed vertex cache optimization.
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+	// Renumbers vertices in order of first use and moves their data to match.
+	static void optimizeVertexFetch(std::vector<float>& vertices, uint32_t components, std::vector<uint32_t>& indices);
+
+private:
+	std::vector<float> m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<uint16_t> m_shortIndices;
+	uint32_t m_components = 0;
+	MeshStats m_stats;
+};
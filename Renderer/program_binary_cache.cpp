@@ -0,0 +1,145 @@
+#include "program_binary_cache.h"
+#include "hash.h"
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const uint32_t CACHE_MAGIC = 0x42504c47;	// "GLPB"
+const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+uint64_t hashGLString(GLenum name, uint64_t seed)
+{
+	auto str = reinterpret_cast<const char*>(glGetString(name));
+	return str ? fnv1a(str, std::char_traits<char>::length(str), seed) : seed;
+}
+
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory)
+	:m_directory(directory)
+{
+	m_driverHash = hashGLString(GL_VENDOR, FNV1A_OFFSET_BASIS);
+	m_driverHash = hashGLString(GL_RENDERER, m_driverHash);
+	m_driverHash = hashGLString(GL_VERSION, m_driverHash);
+
+	if (GLAD_GL_VERSION_4_1) {
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		m_supported = formats > 0;
+	}
+	if (m_supported) {
+		std::error_code ec;
+		std::filesystem::create_directories(m_directory, ec);
+		m_supported = !ec;
+	}
+}
+
+uint64_t ProgramBinaryCache::makeKey(const std::map<GLenum, ShaderSourcePtr>& sources) const
+{
+	uint64_t key = m_driverHash;
+	for (const auto& pair : sources) {
+		auto sourceHash = pair.second->hash();
+		key = fnv1a(reinterpret_cast<const char*>(&pair.first), sizeof(pair.first), key);
+		key = fnv1a(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash), key);
+	}
+	return key;
+}
+
+std::string ProgramBinaryCache::entryPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64 ".bin", key);
+	return (std::filesystem::path(m_directory) / name).string();
+}
+
+bool ProgramBinaryCache::load(GLuint program, uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::ifstream fin(entryPath(key), std::ios::binary);
+	CacheHeader header;
+	if (!fin || !fin.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key) {
+		++m_stats.misses;
+		return false;
+	}
+	std::vector<char> binary(header.length);
+	if (!fin.read(binary.data(), binary.size())) {
+		++m_stats.misses;
+		return false;
+	}
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		++m_stats.rejected;
+		++m_stats.misses;
+		return false;
+	}
+	++m_stats.hits;
+	return true;
+}
+
+bool ProgramBinaryCache::store(GLuint program, uint64_t key)
+{
+	// also keeps two threads from writing the same temporary file
+	std::lock_guard<std::mutex> lock(m_mutex);
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return false;
+	}
+	std::vector<char> binary(length);
+	CacheHeader header = { CACHE_MAGIC, CACHE_VERSION, key, 0, 0 };
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	header.format = format;
+	header.length = static_cast<uint32_t>(length);
+
+	// write to a temporary file first so a crash never leaves a truncated entry behind
+	auto path = entryPath(key);
+	auto tmpPath = path + ".tmp";
+	{
+		std::ofstream fout(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!fout) {
+			return false;
+		}
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(binary.data(), length);
+		if (!fout) {
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+	++m_stats.stores;
+	return true;
+}
+
+ProgramBinaryCacheStats ProgramBinaryCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void ProgramBinaryCache::printStats() const
+{
+	auto current = stats();
+	printf("program binary cache: %u hits, %u misses (%u rejected), %u stored\n",
+		current.hits, current.misses, current.rejected, current.stores);
+}
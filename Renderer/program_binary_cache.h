@@ -0,0 +1,42 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include "shader_source.h"
+
+struct ProgramBinaryCacheStats {
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	uint32_t stores = 0;
+	uint32_t rejected = 0;	// entries found on disk but refused by the driver
+};
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries are keyed by a hash of the stage sources and the driver vendor/renderer/
+// version strings, so a source edit or a driver update simply misses the cache.
+// Must be created while the GL context it is used with is current. Thread safe;
+// ShaderReloader loads and stores programs from its worker thread.
+class ProgramBinaryCache {
+public:
+	explicit ProgramBinaryCache(const std::string& directory);
+
+	bool isSupported() const { return m_supported; }
+	uint64_t makeKey(const std::map<GLenum, ShaderSourcePtr>& sources) const;
+	bool load(GLuint program, uint64_t key);
+	bool store(GLuint program, uint64_t key);
+
+	ProgramBinaryCacheStats stats() const;
+	void printStats() const;
+
+private:
+	std::string entryPath(uint64_t key) const;
+
+private:
+	std::string m_directory;
+	uint64_t m_driverHash = 0;
+	bool m_supported = false;
+	mutable std::mutex m_mutex;
+	ProgramBinaryCacheStats m_stats;
+};
@@ -0,0 +1,167 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <cassert>
+#include "gl_state_cache.h"
+#include "shader.h"
+
+namespace {
+
+const uint64_t NAME_MASK = (1u << 12) - 1;
+const uint64_t DEPTH_MASK = (1u << 24) - 1;
+const int DIGIT_BITS = 11;
+const int DIGITS = (64 + DIGIT_BITS - 1) / DIGIT_BITS;
+const int RADIX = 1 << DIGIT_BITS;
+
+size_t indexSize(GLenum indexType)
+{
+	switch (indexType) {
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_UNSIGNED_SHORT: return 2;
+	default: return 4;
+	}
+}
+
+GLuint programOf(const RenderItem& item)
+{
+	return item.program || !item.shader ? item.program : item.shader->program();
+}
+
+}
+
+uint64_t RenderQueue::makeKey(uint32_t pass, bool transparent, GLuint program, GLuint texture, GLuint vertexArray, float depth)
+{
+	assert(pass < MAX_PASSES);
+	uint64_t quantized = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * DEPTH_MASK);
+	uint64_t state = (program & NAME_MASK) << 24 | (texture & NAME_MASK) << 12 | (vertexArray & NAME_MASK);
+	uint64_t key = static_cast<uint64_t>(pass) << 60;
+	if (transparent) {
+		return key | (DEPTH_MASK - quantized) << 36 | state;
+	}
+	return key | state << 24 | quantized;
+}
+
+void RenderQueue::radixSort(std::vector<RenderQueueEntry>& entries, std::vector<RenderQueueEntry>& scratch)
+{
+	const size_t count = entries.size();
+	if (count < 2) {
+		return;
+	}
+	// the histograms of all digits in one read of the keys
+	std::vector<uint32_t> histograms(DIGITS * RADIX, 0);
+	for (const auto& entry : entries) {
+		for (int digit = 0; digit < DIGITS; ++digit) {
+			++histograms[digit * RADIX + ((entry.key >> (digit * DIGIT_BITS)) & (RADIX - 1))];
+		}
+	}
+
+	scratch.resize(count);
+	auto* source = &entries;
+	auto* target = &scratch;
+	for (int digit = 0; digit < DIGITS; ++digit) {
+		uint32_t* histogram = &histograms[digit * RADIX];
+		int shift = digit * DIGIT_BITS;
+		// a digit all keys share leaves the order as it is
+		if (histogram[(entries.front().key >> shift) & (RADIX - 1)] == count) {
+			continue;
+		}
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < RADIX; ++bucket) {
+			uint32_t size = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += size;
+		}
+		const auto* from = source->data();
+		auto* to = target->data();
+		for (size_t i = 0; i < count; ++i) {
+			to[histogram[(from[i].key >> shift) & (RADIX - 1)]++] = from[i];
+		}
+		std::swap(source, target);
+	}
+	if (source != &entries) {
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::setTransparent(uint32_t pass, bool transparent)
+{
+	assert(pass < MAX_PASSES);
+	if (transparent) {
+		m_transparent |= 1u << pass;
+	} else {
+		m_transparent &= ~(1u << pass);
+	}
+}
+
+void RenderQueue::clear()
+{
+	m_items.clear();
+	m_entries.clear();
+}
+
+void RenderQueue::reserve(size_t count)
+{
+	m_items.reserve(count);
+	m_entries.reserve(count);
+}
+
+void RenderQueue::submit(uint32_t pass, const RenderItem& item, float depth)
+{
+	uint64_t key = makeKey(pass, isTransparent(pass), programOf(item), item.texture, item.vertexArray, depth);
+	m_entries.push_back({ key, static_cast<uint32_t>(m_items.size()) });
+	m_items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+	radixSort(m_entries, m_scratch);
+}
+
+void RenderQueue::execute()
+{
+	auto& state = GLStateCache::current();
+	for (const auto& entry : m_entries) {
+		const auto& item = m_items[entry.item];
+		if (item.shader) {
+			if (item.model) {
+				item.shader->setUniform("model", *item.model);
+			}
+			// uniforms are prepared before binding; on 3.3 contexts flush() binds to edit
+			item.shader->flush();
+		}
+		if (item.program || !item.shader) {
+			state.useProgram(item.program);
+		} else {
+			item.shader->use();
+		}
+		if (item.texture) {
+			state.bindTexture(0, GL_TEXTURE_2D, item.texture);
+		}
+		state.bindVertexArray(item.vertexArray);
+		if (item.indexType == GL_NONE) {
+			glDrawArraysInstanced(item.mode, item.first, item.count, item.instances);
+		} else {
+			const void* offset = reinterpret_cast<const void*>(item.first * indexSize(item.indexType));
+			glDrawElementsInstanced(item.mode, item.count, item.indexType, offset, item.instances);
+		}
+	}
+}
+
+RenderQueueStats RenderQueue::stateChanges() const
+{
+	RenderQueueStats stats;
+	GLuint program = 0;
+	GLuint texture = 0;
+	GLuint vertexArray = 0;
+	for (const auto& entry : m_entries) {
+		const auto& item = m_items[entry.item];
+		GLuint itemProgram = programOf(item);
+		stats.programChanges += itemProgram != program;
+		stats.textureChanges += item.texture && item.texture != texture;
+		stats.vertexArrayChanges += item.vertexArray != vertexArray;
+		program = itemProgram;
+		texture = item.texture ? item.texture : texture;
+		vertexArray = item.vertexArray;
+		++stats.draws;
+	}
+	return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Shader;
+
+// One draw submitted to a RenderQueue. The program, texture (the material) and
+// vertex array are GL names; the texture goes to unit 0 unless it is 0. indexType
+// GL_NONE draws arrays from first, otherwise elements from offset first * index size.
+struct RenderItem {
+	Shader* shader = nullptr;	// flushed before the draw; its program is used if program is 0
+	const glm::mat4* model = nullptr;	// set as the shader's "model" uniform
+	GLuint program = 0;
+	GLuint texture = 0;
+	GLuint vertexArray = 0;
+	GLenum mode = GL_TRIANGLES;
+	GLsizei count = 0;
+	GLenum indexType = GL_NONE;
+	GLint first = 0;
+	GLsizei instances = 1;
+};
+
+struct RenderQueueEntry {
+	uint64_t key;
+	uint32_t item;	// index into RenderQueue::items()
+};
+
+struct RenderQueueStats {
+	uint32_t draws = 0;
+	uint32_t programChanges = 0;
+	uint32_t textureChanges = 0;
+	uint32_t vertexArrayChanges = 0;
+
+	uint32_t total() const { return programChanges + textureChanges + vertexArrayChanges; }
+};
+
+// Draws sorted by a 64-bit key, most significant field first:
+//   opaque passes:      pass:4 program:12 texture:12 vertexArray:12 depth:24
+//   transparent passes: pass:4 depth:24 program:12 texture:12 vertexArray:12
+// so opaque draws are grouped by state and go front to back within a group, and
+// transparent ones go back to front (their depth is inverted). Names are keyed by
+// their low 12 bits; names that collide still draw correctly, only grouped worse.
+// The keys are sorted by an LSD radix sort, 11 bits per pass, skipping the passes
+// in which every key has the same digit. execute() binds through GLStateCache, which
+// drops the binds that sorting made redundant.
+class RenderQueue {
+public:
+	static const uint32_t MAX_PASSES = 16;
+
+	// Depth is the normalized view distance, 0 at the near plane and 1 at the far one.
+	static uint64_t makeKey(uint32_t pass, bool transparent, GLuint program, GLuint texture, GLuint vertexArray, float depth);
+	// Sorts entries by key, stable, using scratch as the second buffer.
+	static void radixSort(std::vector<RenderQueueEntry>& entries, std::vector<RenderQueueEntry>& scratch);
+
+	void setTransparent(uint32_t pass, bool transparent);
+	bool isTransparent(uint32_t pass) const { return (m_transparent >> pass) & 1; }
+
+	void clear();
+	void reserve(size_t count);
+	void submit(uint32_t pass, const RenderItem& item, float depth);
+	void sort();
+	// Draws the items in entry order; sort() first.
+	void execute();
+
+	size_t size() const { return m_items.size(); }
+	const std::vector<RenderItem>& items() const { return m_items; }
+	const std::vector<RenderQueueEntry>& entries() const { return m_entries; }
+	// The state changes executing the entries in their current order takes.
+	RenderQueueStats stateChanges() const;
+
+private:
+	std::vector<RenderItem> m_items;
+	std::vector<RenderQueueEntry> m_entries;
+	std::vector<RenderQueueEntry> m_scratch;
+	uint32_t m_transparent = 0;
+};
@@ -0,0 +1,41 @@
+#include "render_target.h"
+#include "gl_state_cache.h"
+
+RenderTarget::RenderTarget(GLsizei width, GLsizei height)
+	:m_width(width)
+	,m_height(height)
+{
+	glGenRenderbuffers(2, m_renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	GLStateCache::current().bindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_renderbuffers[1]);
+	m_complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+RenderTarget::~RenderTarget()
+{
+	glDeleteFramebuffers(1, &m_framebuffer);
+	GLStateCache::current().onDeleteFramebuffer(m_framebuffer);
+	glDeleteRenderbuffers(2, m_renderbuffers);
+}
+
+void RenderTarget::bind()
+{
+	auto& state = GLStateCache::current();
+	state.bindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	state.viewport(0, 0, m_width, m_height);
+}
+
+void RenderTarget::readPixels(std::vector<uint8_t>& pixels)
+{
+	pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+	GLStateCache::current().bindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+// Offscreen framebuffer with an RGBA8 color and a depth/stencil renderbuffer,
+// used as the back buffer when there is no window.
+class RenderTarget {
+public:
+	RenderTarget(GLsizei width, GLsizei height);
+	~RenderTarget();
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	bool isComplete() const { return m_complete; }
+	GLsizei width() const { return m_width; }
+	GLsizei height() const { return m_height; }
+	GLuint framebuffer() const { return m_framebuffer; }
+
+	// Binds for drawing and sets the viewport to the whole target.
+	void bind();
+	// Reads the color attachment back, RGBA8 rows bottom to top.
+	void readPixels(std::vector<uint8_t>& pixels);
+
+private:
+	GLuint m_framebuffer = 0;
+	GLuint m_renderbuffers[2] = {};
+	GLsizei m_width;
+	GLsizei m_height;
+	bool m_complete = false;
+};
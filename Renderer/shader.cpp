@@ -1,9 +1,25 @@
 ﻿#include "shader.h"
+#include "gl_state_cache.h"
+#include "hash.h"
+#include "program_binary_cache.h"
+#include "shader_stage_cache.h"
+#include "uniform_block.h"
+#include <cassert>
 #include <iostream>
-#include <filesystem>
-#include <fstream>
-#include <sstream>
 
+namespace {
+ProgramBinaryCache* s_binaryCache = nullptr;
+ShaderStageCache* s_stageCache = nullptr;
+ShaderTelemetry* s_telemetry = nullptr;
+bool s_directStateAccessEnabled = true;
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+}
 
 Shader::Shader()
 {
@@ -24,8 +40,12 @@ Shader::~Shader()
 {
 	clearShaders();
 	if (m_program) {
-		unuse();
+		auto& state = GLStateCache::current();
+		if (state.program() == m_program) {
+			unuse();
+		}
 		glDeleteProgram(m_program);
+		state.onDeleteProgram(m_program);
 		m_program = 0;
 	}
 }
@@ -34,7 +54,12 @@ void Shader::clearShaders()
 {
 	for (const auto pair : m_shaderMap) {
 		if (pair.second) {
-			glDeleteShader(pair.second);
+			glDetachShader(m_program, pair.second);
+			if (s_stageCache) {
+				s_stageCache->release(pair.second);
+			} else {
+				glDeleteShader(pair.second);
+			}
 		}
 	}
 	m_shaderMap.clear();
@@ -48,152 +73,323 @@ void Shader::clearShaders()
 
 bool Shader::attachShaderSource(GLenum shaderType, const std::string& shaderSource, std::string* log)
 {
-	if (m_shaderMap.find(shaderType) != m_shaderMap.end()) {
+	return attachShaderSource(shaderType, ShaderSource::fromString(shaderSource), log);
+}
+
+bool Shader::attachShaderSource(GLenum shaderType, ShaderSourcePtr shaderSource, std::string* log)
+{
+	if (m_sources.find(shaderType) != m_sources.end()) {
 		ERROR_STRING("shader type already added !");
 		return false;
 	}
+	if (auto telemetry = record()) {
+		++telemetry->stages;
+		telemetry->sourceBytes += shaderSource->size();
+	}
+	m_sources[shaderType] = std::move(shaderSource);
+	if (deferStages()) {
+		// compiled by compile() or ShaderBatch::submit(), unless the binary is cached
+		return true;
+	}
+	auto start = Clock::now();
+	auto success = compileStage(shaderType, log);
+	if (m_telemetry) {
+		m_telemetry->compileMs += millisecondsSince(start);
+	}
+	return success;
+}
+
+void Shader::setSeparable(bool separable)
+{
+	assert(GLAD_GL_VERSION_4_1);
+	m_separable = separable;
+	glProgramParameteri(m_program, GL_PROGRAM_SEPARABLE, separable ? GL_TRUE : GL_FALSE);
+}
+
+bool Shader::deferStages() const
+{
+	return m_batched || (s_binaryCache && s_binaryCache->isSupported());
+}
+
+void Shader::submitStage(GLenum shaderType)
+{
+	GLuint shaderId;
+	if (s_stageCache) {
+		bool hit = false;
+		shaderId = s_stageCache->acquire(shaderType, *m_sources[shaderType], &hit);
+		if (m_telemetry) {
+			++(hit ? m_telemetry->stageCacheHits : m_telemetry->stageCacheMisses);
+		}
+	} else {
+		const auto& source = *m_sources[shaderType];
+		shaderId = glCreateShader(shaderType);
+		glShaderSource(shaderId, source.count(), source.strings(), source.lengths());
+		glCompileShader(shaderId);
+	}
+	glAttachShader(m_program, shaderId);
+	m_shaderMap[shaderType] = shaderId;
+}
+
+bool Shader::compileStage(GLenum shaderType, std::string* log)
+{
 	int success;
-	auto shaderId = glCreateShader(shaderType);
-	auto shaderStr = shaderSource.c_str();
-	glShaderSource(shaderId, 1, &shaderStr, nullptr);
-	glCompileShader(shaderId);
+	submitStage(shaderType);
+	auto shaderId = m_shaderMap[shaderType];
 	glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
 	if (!success) {
 		if (log) {
 			int iLen;
 			glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &iLen);
-			log->resize(iLen);
-			glGetShaderInfoLog(shaderId, iLen + 1, nullptr, log->data());
+			std::string stageLog(iLen, '\0');
+			glGetShaderInfoLog(shaderId, iLen, nullptr, stageLog.data());
+			*log = m_sources[shaderType]->mapLog(stageLog.c_str());
 		}
 	}
-	glAttachShader(m_program, shaderId);
-	m_shaderMap[shaderType] = shaderId;
 	return success;
 }
 
 bool Shader::attachShaderFile(GLenum shaderType, const std::string& shaderFilePath, std::string* log)
 {
-	std::filesystem::path sourceFilePath(shaderFilePath);
-	if (!std::filesystem::exists(sourceFilePath)) {
-		ERROR_STRING("file not exist !");
+	auto source = ShaderSourceCache::shared().load(shaderFilePath, log);
+	if (!source) {
 		return false;
 	}
-	std::ifstream fin(sourceFilePath);
-	if (!fin) {
-		ERROR_STRING("open file failed !");
-		return false;
-	}
-	std::stringstream ss;
-	ss << fin.rdbuf();
-	std::string strShader(ss.str());
-	if (!strShader.length()) {
-		ERROR_STRING("file content empty !");
-		return false;
+	bool duplicate = m_sources.count(shaderType) != 0;
+	auto success = attachShaderSource(shaderType, std::move(source), log);
+	// keep watching a file that failed to compile, so fixing it can reload it
+	if (!duplicate) {
+		if (m_telemetry) {
+			m_telemetry->name = m_sourceFiles.empty() ? shaderFilePath : m_telemetry->name + ", " + shaderFilePath;
+		}
+		m_sourceFiles[shaderType] = shaderFilePath;
 	}
-	return attachShaderSource(shaderType, strShader.c_str(), log);
+	return success;
 }
 
-bool Shader::setUniform(int location, glm::vec3 vec)
+GLint Shader::uniformLocation(UniformName name) const
 {
-	if (-1 == location) {
-		return false;
-	}
-	glUniform3f(location, vec.x, vec.y, vec.z);
-	return true;
+	auto info = m_uniforms.find(name.hash());
+	return info ? info->location : -1;
 }
 
+void Shader::use()
+{
+	assert(m_program);
+	GLStateCache::current().useProgram(m_program);
+}
 
-bool Shader::setUniform(const std::string& name, glm::vec3 vec)
+void Shader::unuse()
 {
-	auto location = glGetUniformLocation(m_program, name.c_str());
-	return setUniform(location, vec);
+	GLStateCache::current().useProgram(0);
 }
 
-bool Shader::setUniform(int location, glm::vec4 vec)
+void Shader::flush()
 {
-	if (-1 == location) {
-		return false;
+	if (!m_state.isDirty()) {
+		return;
 	}
-	glUniform4f(location, vec.x, vec.y, vec.z, vec.w);
-	return true;
+	if (hasDirectStateAccess()) {
+		m_state.flush(m_program);
+		return;
+	}
+	GLStateCache::current().useProgram(m_program);
+	m_state.flush();
 }
 
+bool Shader::hasDirectStateAccess()
+{
+	return s_directStateAccessEnabled && GLAD_GL_VERSION_4_1;
+}
 
-bool Shader::setUniform(const std::string& name, glm::vec4 vec)
+void Shader::setDirectStateAccessEnabled(bool enabled)
 {
-	auto location = glGetUniformLocation(m_program, name.c_str());
-	return setUniform(location, vec);
+	s_directStateAccessEnabled = enabled;
 }
 
-bool Shader::setUniform(int location, glm::vec2 vec)
+void Shader::setBinaryCache(ProgramBinaryCache* cache)
 {
-	if (-1 == location) {
-		return false;
-	}
-	glUniform2f(location, vec.x, vec.y);
-	return true;
+	s_binaryCache = cache;
 }
 
-bool Shader::setUniform(const std::string& name, glm::vec2 vec)
+ProgramBinaryCache* Shader::binaryCache()
 {
-	auto location = glGetUniformLocation(m_program, name.c_str());
-	return setUniform(location, vec);
+	return s_binaryCache;
 }
 
-bool Shader::setUniform(int location, glm::mat4 mat4, bool bNormalize)
+void Shader::setStageCache(ShaderStageCache* cache)
 {
-	if (-1 == location)
-		return false;
-	glUniformMatrix4fv(location, 1, bNormalize ? GL_TRUE : GL_FALSE, glm::value_ptr(mat4));
-	return true;
+	s_stageCache = cache;
 }
 
-bool Shader::setUniform(const std::string& name, glm::mat4 mat4, bool bNormalize)
+ShaderStageCache* Shader::stageCache()
 {
-	auto location = glGetUniformLocation(m_program, name.c_str());
-	return setUniform(location, mat4, bNormalize);
+	return s_stageCache;
 }
 
-bool Shader::setUniform(int location, GLint value)
+void Shader::setTelemetry(ShaderTelemetry* telemetry)
 {
-	if (-1 == location) {
-		return false;
+	s_telemetry = telemetry;
+}
+
+ShaderTelemetry* Shader::telemetry()
+{
+	return s_telemetry;
+}
+
+ShaderTelemetryRecord* Shader::record()
+{
+	if (!m_telemetry && s_telemetry) {
+		m_telemetry = s_telemetry->addRecord();
+		m_telemetry->program = m_program;
+		m_telemetry->name = "program " + std::to_string(m_program);
 	}
-	glUniform1i(location, value);
-	return true;
+	return m_telemetry;
 }
 
-bool Shader::setUniform(const std::string& name, GLint value)
+bool Shader::compile(std::string* log)
 {
-	auto location = glGetUniformLocation(m_program, name.c_str());
-	return setUniform(location, value);
+	if (submitStages()) {
+		return true;
+	}
+	submitLink();
+	return finishLink(log);
 }
 
+bool Shader::submitStages()
+{
+	auto start = Clock::now();
+	record();
+	m_storeBinary = false;
+	auto cache = (s_binaryCache && s_binaryCache->isSupported()) ? s_binaryCache : nullptr;
+	if (cache) {
+		m_binaryKey = binaryKey(m_sources, m_separable);
+		if (cache->load(m_program, m_binaryKey)) {
+			clearShaders();
+			reflect(true);
+			if (m_telemetry) {
+				m_telemetry->binaryCache = BinaryCacheResult::Hit;
+				m_telemetry->compileMs += millisecondsSince(start);
+				m_telemetry->linked = true;
+			}
+			return true;
+		}
+		if (m_telemetry) {
+			m_telemetry->binaryCache = BinaryCacheResult::Miss;
+		}
+		glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		m_storeBinary = true;
+	}
+	for (const auto& pair : m_sources) {
+		if (m_shaderMap.find(pair.first) == m_shaderMap.end()) {
+			submitStage(pair.first);
+		}
+	}
+	if (m_telemetry) {
+		m_telemetry->compileMs += millisecondsSince(start);
+	}
+	return false;
+}
 
-void Shader::use()
+void Shader::submitLink()
 {
-	assert(m_program);
-	glUseProgram(m_program);
+	m_linkStart = Clock::now();
+	glLinkProgram(m_program);
 }
 
-void Shader::unuse()
+bool Shader::isLinkComplete() const
 {
-	glUseProgram(0);
+	if (!GLAD_GL_KHR_parallel_shader_compile) {
+		return true;
+	}
+	GLint complete = GL_FALSE;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
 }
 
-bool Shader::compile(std::string* log)
+bool Shader::finishLink(std::string* log)
 {
 	GLint success;
-	glLinkProgram(m_program);
-	clearShaders();
 	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+	if (m_telemetry) {
+		m_telemetry->linkMs += millisecondsSince(m_linkStart);
+		m_telemetry->linked = success == GL_TRUE;
+	}
 	if (!success) {
 		if (log) {
+			log->clear();
+			for (const auto& pair : m_shaderMap) {
+				GLint compiled = GL_FALSE;
+				glGetShaderiv(pair.second, GL_COMPILE_STATUS, &compiled);
+				if (compiled) {
+					continue;
+				}
+				int iLen = 0;
+				glGetShaderiv(pair.second, GL_INFO_LOG_LENGTH, &iLen);
+				std::string stageLog(iLen, '\0');
+				glGetShaderInfoLog(pair.second, iLen, nullptr, stageLog.data());
+				log->append(m_sources.at(pair.first)->mapLog(stageLog.c_str()));
+			}
 			int iLen = 0;
 			glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &iLen);
-			log->resize(iLen);
-			glGetProgramInfoLog(m_program, iLen, nullptr, log->data());
+			std::string programLog(iLen, '\0');
+			glGetProgramInfoLog(m_program, iLen, nullptr, programLog.data());
+			log->append(programLog.c_str());
 		}
+		clearShaders();
+		reflect(false);
+		return false;
 	}
-	return success;
+	clearShaders();
+	if (m_storeBinary) {
+		s_binaryCache->store(m_program, m_binaryKey);
+		m_storeBinary = false;
+	}
+	reflect(true);
+	return true;
+}
+
+uint64_t Shader::binaryKey(const std::map<GLenum, ShaderSourcePtr>& sources, bool separable)
+{
+	auto key = s_binaryCache->makeKey(sources);
+	// a separable binary must not be handed to a monolithic program
+	return separable ? fnv1a("separable", 9, key) : key;
+}
+
+void Shader::replaceProgram(GLuint program, std::map<GLenum, ShaderSourcePtr> sources)
+{
+	auto& state = GLStateCache::current();
+	bool bound = state.program() == m_program;
+	UniformTable previousTable = std::move(m_uniforms);
+	UniformState previousState = std::move(m_state);
+	glDeleteProgram(m_program);
+	state.onDeleteProgram(m_program);
+	m_program = program;
+	m_sources = std::move(sources);
+	if (m_telemetry) {
+		m_telemetry->program = program;
+		++m_telemetry->reloads;
+	}
+	reflect(true);
+	m_state.restore(previousTable, previousState);
+	if (bound) {
+		use();
+	}
+}
+
+void Shader::reflect(bool linked)
+{
+	if (linked) {
+		UniformBlockRegistry::bindProgram(m_program);
+		m_uniforms.build(m_program);
+		m_state.build(m_program, m_uniforms);
+		if (m_telemetry) {
+			glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &m_telemetry->activeUniforms);
+			glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &m_telemetry->activeUniformBlocks);
+			glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTES, &m_telemetry->activeAttributes);
+		}
+	} else {
+		m_state.clear();
+		m_uniforms.clear();
+	}
+	++m_generation;
 }
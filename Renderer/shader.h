@@ -1,69 +1,206 @@
 #pragma once
 #include <glad/glad.h>
 #include <glm/common.hpp>
+#include <chrono>
 #include <string>
 #include <map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "shader_source.h"
+#include "shader_telemetry.h"
+#include "uniform.h"
+#include "uniform_state.h"
+#include "uniform_table.h"
+
+class ProgramBinaryCache;
+class ShaderBatch;
+class ShaderReloader;
+class ShaderStageCache;
 
 class Shader {
 public:
 	Shader();
 	Shader(const std::string& vertSource, const std::string& fragSource);
 	~Shader();
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
 
 public:
 	bool attachShaderSource(GLenum shaderType, const std::string& shaderSource, std::string* log = nullptr);
+	bool attachShaderSource(GLenum shaderType, ShaderSourcePtr shaderSource, std::string* log = nullptr);
+	// Loads through ShaderSourceCache::shared(), resolving #include directives.
 	bool attachShaderFile(GLenum shaderType, const std::string& shaderFilePath, std::string* log = nullptr);
 	bool compile(std::string* log = nullptr);
 	void use();
 	void unuse();
+
+	GLuint program() const { return m_program; }
+	// Links the program with GL_PROGRAM_SEPARABLE so its stages can be combined with
+	// other programs in a ShaderPipeline (GL 4.1). Must be set before compile().
+	void setSeparable(bool separable);
+	bool isSeparable() const { return m_separable; }
+	// Files attached with attachShaderFile.
+	const std::map<GLenum, std::string>& sourceFiles() const { return m_sourceFiles; }
+	// The source of every stage, as compiled; ShaderReloader rebuilds from these.
+	const std::map<GLenum, ShaderSourcePtr>& sources() const { return m_sources; }
+
+	GLint uniformLocation(UniformName name) const;
+	const UniformTable& uniforms() const { return m_uniforms; }
+	const UniformStats& uniformStats() const { return m_state.stats(); }
+	void resetUniformStats() { m_state.resetStats(); }
+
+	// When a binary cache is installed, stage compilation is deferred to compile() and
+	// skipped entirely when a matching program binary is found.
+	static void setBinaryCache(ProgramBinaryCache* cache);
+	static ProgramBinaryCache* binaryCache();
+
+	// When a stage cache is installed, programs share compiled shader objects with
+	// identical stage type and source instead of compiling them again.
+	static void setStageCache(ShaderStageCache* cache);
+	static ShaderStageCache* stageCache();
+
+	// When telemetry is installed, every Shader records its compile and link times,
+	// cache results and active resource counts; ShaderPrewarmer adds the time of
+	// the first draw, where lazily compiling drivers finish the work.
+	static void setTelemetry(ShaderTelemetry* telemetry);
+	static ShaderTelemetry* telemetry();
+	// nullptr unless the shader was built while telemetry was installed
+	const ShaderTelemetryRecord* telemetryRecord() const { return m_telemetry; }
+
+	// Whether flush() can update unbound programs through glProgramUniform* (GL 4.1).
+	// Otherwise flush() binds the program first.
+	static bool hasDirectStateAccess();
+	static void setDirectStateAccessEnabled(bool enabled);
 public:
-	/*template<typename T>
-	bool setUniform(const std::string& name, T value)
-	{
-		auto location = glGetUniformLocation(m_program, name.c_str());
-		if (-1 == location) {
-			return false;
-		}
-		switch (constexpr typeid(T).hash_code()) {
-		case typeid(GLuint).hash_code(): {
-			glUniform1ui(location, value);
-		}break;
-		case typeid(GLint).hash_code():
-			case typeid(bool) : {
-				glUniform1i(location, value);
-			}break;
-			case typeid(GLfloat).hash_code(): {
-				glUniform1f(location, value);
-			}break;
-			case typeid(GLdouble).hash_code(): {
-				glUniform1d(location, value);
-			}break;
-			default:
-				return false;
-				break;
-		}
-		return true;
-	}*/
-	bool setUniform(int location, glm::vec2 vec);
-	bool setUniform(const std::string& name, glm::vec2 vec);
-	bool setUniform(int location, glm::vec3 vec);
-	bool setUniform(const std::string& name, glm::vec3 vec);
-	bool setUniform(int location, glm::vec4 vec);
-	bool setUniform(const std::string& name, glm::vec4 vec);
-	bool setUniform(int location, glm::mat4 mat4, bool bNormalize = false);
-	bool setUniform(const std::string& name, glm::mat4 mat4, bool bNormalize = false);
+	// Resolves a typed handle once; returns an invalid handle if the program has no
+	// active uniform of that name or its GLSL type does not match T.
+	template<typename T>
+	Uniform<T> uniform(UniformName name);
 
-	bool setUniform(int location, GLint value);
-	bool setUniform(const std::string& name, GLint value);
+	// T may be a float/int/uint/bool scalar, any glm vector or float matrix, or a
+	// C array, std::array or std::vector of those. Setters only update the shadow
+	// state; nothing reaches the driver before flush().
+	template<typename T>
+	bool setUniform(GLint location, const T& value);
+	template<typename T>
+	bool setUniform(UniformName name, const T& value);
+	template<typename T>
+	bool setUniform(UniformName name, const T* values, GLsizei count);
 
+	// Uploads the uniforms changed since the last flush. With direct state access
+	// this does not touch the program binding, so all programs can be flushed ahead
+	// of the draw loop; on 3.3 contexts the program is bound to edit it.
+	void flush();
 
 private:
+	friend class ShaderBatch;
+	friend class ShaderPrewarmer;
+	friend class ShaderReloader;
+	template<typename T> friend class Uniform;
+
+	template<typename T>
+	bool writeUniform(const UniformInfo& info, const T* values, GLsizei count);
+	void reflect(bool linked);
+	// ProgramBinaryCache key of a program linked from sources.
+	static uint64_t binaryKey(const std::map<GLenum, ShaderSourcePtr>& sources, bool separable);
+	// Swaps in a program linked elsewhere (e.g. on a shared context) from sources and
+	// carries the uniform values of the old program over.
+	void replaceProgram(GLuint program, std::map<GLenum, ShaderSourcePtr> sources);
+
+	bool deferStages() const;
+	bool compileStage(GLenum shaderType, std::string* log);
+	void submitStage(GLenum shaderType);
+	// Non-blocking half of compile(): restores the program from the binary cache or
+	// sends every pending stage compile. Returns true on a binary cache hit.
+	bool submitStages();
+	void submitLink();
+	bool isLinkComplete() const;
+	// Blocking half of compile(): queries the link status and collects the logs.
+	bool finishLink(std::string* log);
 	void clearShaders();
+	ShaderTelemetryRecord* record();
 
 private:
 	GLuint m_program = 0;
+	bool m_batched = false;
+	bool m_separable = false;
+	bool m_storeBinary = false;
+	uint64_t m_binaryKey = 0;
+	std::map<GLenum, ShaderSourcePtr> m_sources;
+	std::map<GLenum, std::string> m_sourceFiles;
 	std::map<GLenum, GLuint> m_shaderMap;
+	UniformTable m_uniforms;
+	UniformState m_state;
+	uint32_t m_generation = 1;	// bumped whenever m_uniforms is rebuilt
+	ShaderTelemetryRecord* m_telemetry = nullptr;
+	std::chrono::steady_clock::time_point m_linkStart;
 };
+
+template<typename T>
+Uniform<T> Shader::uniform(UniformName name)
+{
+	auto info = m_uniforms.find(name.hash());
+	if (!info || !isUniformTypeCompatible<T>(info->type)) {
+		return Uniform<T>();
+	}
+	Uniform<T> handle(this, name.hash());
+	handle.m_info = info;
+	handle.m_generation = m_generation;
+	return handle;
+}
+
+template<typename T>
+bool Shader::setUniform(GLint location, const T& value)
+{
+	using Value = UniformValue<T>;
+	auto info = m_uniforms.findByLocation(location);
+	return info && writeUniform(*info, Value::data(value), Value::count(value));
+}
+
+template<typename T>
+bool Shader::setUniform(UniformName name, const T& value)
+{
+	using Value = UniformValue<T>;
+	return setUniform(name, Value::data(value), Value::count(value));
+}
+
+template<typename T>
+bool Shader::setUniform(UniformName name, const T* values, GLsizei count)
+{
+	auto info = m_uniforms.find(name.hash());
+	return info && writeUniform(*info, values, count);
+}
+
+template<typename T>
+bool Shader::writeUniform(const UniformInfo& info, const T* values, GLsizei count)
+{
+	using Storage = UniformStorage<T>;
+	using StorageType = typename Storage::Type;
+	if (count <= 0 || count > info.size || !isUniformTypeCompatible<T>(info.type)) {
+		return false;
+	}
+	auto bytes = static_cast<uint32_t>(sizeof(StorageType) * count);
+	if constexpr (std::is_same_v<StorageType, T>) {
+		return m_state.write(info, values, bytes, &uploadUniformData<T>);
+	} else {
+		std::vector<StorageType> converted(count);
+		for (GLsizei i = 0; i < count; ++i) {
+			converted[i] = Storage::convert(values[i]);
+		}
+		return m_state.write(info, converted.data(), bytes, &uploadUniformData<StorageType>);
+	}
+}
+
+template<typename T>
+bool Uniform<T>::set(const T* values, GLsizei count) const
+{
+	if (!m_shader) {
+		return false;
+	}
+	if (m_generation != m_shader->m_generation) {
+		m_info = m_shader->m_uniforms.find(m_hash);
+		m_generation = m_shader->m_generation;
+	}
+	return m_info && m_shader->writeUniform(*m_info, values, count);
+}
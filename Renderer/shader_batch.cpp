@@ -0,0 +1,79 @@
+#include "shader_batch.h"
+#include "shader.h"
+#include <cassert>
+
+ShaderBatch::ShaderBatch()
+{
+	if (isParallelCompileSupported()) {
+		// let the driver use as many compiler threads as it wants
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+}
+
+bool ShaderBatch::isParallelCompileSupported()
+{
+	return GLAD_GL_KHR_parallel_shader_compile != 0;
+}
+
+void ShaderBatch::add(Shader& shader)
+{
+	assert(!m_submitted);
+	shader.m_batched = true;
+	Entry entry;
+	entry.shader = &shader;
+	m_entries.push_back(entry);
+}
+
+void ShaderBatch::submit()
+{
+	assert(!m_submitted);
+	m_submitted = true;
+	m_pending = m_entries.size();
+	// all stage compiles first, then all links, so no link waits behind a compile
+	// of an unrelated program
+	for (auto& entry : m_entries) {
+		if (entry.shader->submitStages()) {
+			entry.shader->m_batched = false;
+			entry.done = true;
+			entry.success = true;
+			--m_pending;
+		}
+	}
+	for (auto& entry : m_entries) {
+		if (!entry.done) {
+			entry.shader->submitLink();
+		}
+	}
+}
+
+void ShaderBatch::finish(Entry& entry)
+{
+	entry.success = entry.shader->finishLink(&entry.log);
+	entry.shader->m_batched = false;
+	entry.done = true;
+	--m_pending;
+}
+
+bool ShaderBatch::poll()
+{
+	assert(m_submitted);
+	for (auto& entry : m_entries) {
+		if (!entry.done && entry.shader->isLinkComplete()) {
+			finish(entry);
+		}
+	}
+	return m_pending == 0;
+}
+
+bool ShaderBatch::wait()
+{
+	assert(m_submitted);
+	bool success = true;
+	for (auto& entry : m_entries) {
+		if (!entry.done) {
+			finish(entry);
+		}
+		success = success && entry.success;
+	}
+	return success;
+}
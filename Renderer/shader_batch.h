@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+class Shader;
+
+// Compiles and links many programs without serializing on status queries.
+// Usage: add() every Shader before attaching its sources, attach the sources
+// (they are only recorded), then submit() and wait() or poll() until done.
+// All compile and link commands are issued by submit(); status and log queries
+// happen in wait()/poll(), so drivers with background compiler threads
+// (KHR_parallel_shader_compile) can work on every program at the same time.
+class ShaderBatch {
+public:
+	ShaderBatch();
+
+	void add(Shader& shader);
+	void submit();
+	// Finalizes the programs that have finished linking and returns true once all
+	// have. Without KHR_parallel_shader_compile completion cannot be queried without
+	// blocking, so poll() behaves like wait().
+	bool poll();
+	// Blocks until every program is linked. Returns false if any of them failed.
+	bool wait();
+
+	size_t size() const { return m_entries.size(); }
+	size_t pending() const { return m_pending; }
+	bool succeeded(size_t index) const { return m_entries[index].success; }
+	const std::string& log(size_t index) const { return m_entries[index].log; }
+
+	static bool isParallelCompileSupported();
+
+private:
+	struct Entry {
+		Shader* shader = nullptr;
+		bool done = false;
+		bool success = false;
+		std::string log;
+	};
+
+	void finish(Entry& entry);
+
+private:
+	std::vector<Entry> m_entries;
+	size_t m_pending = 0;
+	bool m_submitted = false;
+};
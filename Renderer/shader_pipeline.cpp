@@ -0,0 +1,95 @@
+#include "shader_pipeline.h"
+#include "gl_state_cache.h"
+#include "shader.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+ShaderPipeline::ShaderPipeline()
+{
+	assert(isSupported());
+	glGenProgramPipelines(1, &m_pipeline);
+}
+
+ShaderPipeline::~ShaderPipeline()
+{
+	if (m_pipeline) {
+		auto& state = GLStateCache::current();
+		if (state.programPipeline() == m_pipeline) {
+			unbind();
+		}
+		glDeleteProgramPipelines(1, &m_pipeline);
+		state.onDeleteProgramPipeline(m_pipeline);
+		m_pipeline = 0;
+	}
+}
+
+bool ShaderPipeline::isSupported()
+{
+	return GLAD_GL_VERSION_4_1;
+}
+
+void ShaderPipeline::setStages(GLbitfield stages, Shader* shader)
+{
+	assert(!shader || shader->isSeparable());
+	for (auto& stage : m_stages) {
+		stage.bits &= ~stages;
+	}
+	m_stages.erase(std::remove_if(m_stages.begin(), m_stages.end(),
+		[](const Stage& stage) { return stage.bits == 0; }), m_stages.end());
+	GLuint program = shader ? shader->program() : 0;
+	if (shader) {
+		m_stages.push_back({ stages, shader, program });
+	}
+	glUseProgramStages(m_pipeline, stages, program);
+}
+
+bool ShaderPipeline::validate(std::string* log)
+{
+	syncStages();
+	glValidateProgramPipeline(m_pipeline);
+	GLint success = GL_FALSE;
+	glGetProgramPipelineiv(m_pipeline, GL_VALIDATE_STATUS, &success);
+	if (!success) {
+		int iLen = 0;
+		glGetProgramPipelineiv(m_pipeline, GL_INFO_LOG_LENGTH, &iLen);
+		std::string message(iLen, '\0');
+		glGetProgramPipelineInfoLog(m_pipeline, iLen, nullptr, message.data());
+		if (log) {
+			*log = message.c_str();
+		} else {
+			std::cout << message.c_str();
+		}
+	}
+	return success == GL_TRUE;
+}
+
+void ShaderPipeline::flush()
+{
+	for (const auto& stage : m_stages) {
+		stage.shader->flush();
+	}
+}
+
+void ShaderPipeline::bind()
+{
+	syncStages();
+	auto& state = GLStateCache::current();
+	state.useProgram(0);
+	state.bindProgramPipeline(m_pipeline);
+}
+
+void ShaderPipeline::unbind()
+{
+	GLStateCache::current().bindProgramPipeline(0);
+}
+
+void ShaderPipeline::syncStages()
+{
+	for (auto& stage : m_stages) {
+		if (stage.program != stage.shader->program()) {
+			stage.program = stage.shader->program();
+			glUseProgramStages(m_pipeline, stage.bits, stage.program);
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+class Shader;
+
+// Program pipeline object combining the stages of separable programs (GL 4.1).
+// With M vertex and N fragment variants only M+N separable programs are linked
+// instead of M*N monolithic ones; the combination is chosen at bind time.
+// Stage programs are ordinary Shaders with setSeparable(true), so they keep the
+// binary cache, typed uniforms and hot reload. A reloaded stage is picked up by
+// the next bind().
+class ShaderPipeline {
+public:
+	ShaderPipeline();
+	~ShaderPipeline();
+	ShaderPipeline(const ShaderPipeline&) = delete;
+	ShaderPipeline& operator=(const ShaderPipeline&) = delete;
+
+	static bool isSupported();
+
+	// Uses the given stages (GL_VERTEX_SHADER_BIT, GL_FRAGMENT_SHADER_BIT, ...) of a
+	// separable shader; nullptr removes them from the pipeline.
+	void setStages(GLbitfield stages, Shader* shader);
+	bool validate(std::string* log = nullptr);
+
+	// Uploads pending uniforms of every stage program. Call before bind(): on
+	// contexts without direct state access flushing binds the stage program.
+	void flush();
+	// Clears the current program, which would otherwise take precedence.
+	void bind();
+	void unbind();
+
+	GLuint pipeline() const { return m_pipeline; }
+
+private:
+	struct Stage {
+		GLbitfield bits;
+		Shader* shader;
+		GLuint program;	// program last attached, to notice reloads
+	};
+
+	void syncStages();
+
+private:
+	GLuint m_pipeline = 0;
+	std::vector<Stage> m_stages;
+};
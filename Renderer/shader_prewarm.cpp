@@ -0,0 +1,134 @@
+#include "shader_prewarm.h"
+#include "gl_state_cache.h"
+#include "shader.h"
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double timedDraw(GLenum mode, GLsizei vertexCount)
+{
+	auto start = Clock::now();
+	glDrawArrays(mode, 0, vertexCount);
+	glFinish();
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+}
+
+ShaderPrewarmer::ShaderPrewarmer(GLenum colorFormat, GLenum depthFormat)
+{
+	glGenRenderbuffers(2, m_renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, 1, 1);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, 1, 1);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	auto& state = GLStateCache::current();
+	GLint previous = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &m_framebuffer);
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffers[0]);
+	auto depthAttachment = depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8
+		? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+	glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, depthAttachment, GL_RENDERBUFFER, m_renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("shader prewarm: framebuffer incomplete\n");
+	}
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+}
+
+ShaderPrewarmer::~ShaderPrewarmer()
+{
+	glDeleteFramebuffers(1, &m_framebuffer);
+	GLStateCache::current().onDeleteFramebuffer(m_framebuffer);
+	glDeleteRenderbuffers(2, m_renderbuffers);
+}
+
+void ShaderPrewarmer::add(Shader& shader, GLuint vao, const PrewarmState& state, GLenum mode, GLsizei vertexCount)
+{
+	m_pending.push_back({ &shader, vao, state, mode, vertexCount });
+}
+
+void ShaderPrewarmer::applyState(const PrewarmState& prewarm)
+{
+	auto& state = GLStateCache::current();
+	state.setEnabled(GL_DEPTH_TEST, prewarm.depthTest);
+	state.setEnabled(GL_BLEND, prewarm.blend);
+	state.setEnabled(GL_CULL_FACE, prewarm.cullFace);
+	if (prewarm.blend) {
+		state.blendFunc(prewarm.blendSrc, prewarm.blendDst);
+	}
+}
+
+size_t ShaderPrewarmer::run()
+{
+	if (m_pending.empty()) {
+		return 0;
+	}
+	auto& state = GLStateCache::current();
+	GLint framebuffer = 0;
+	GLint vao = 0;
+	GLint viewport[4];
+	GLint blendSrc = GL_ONE;
+	GLint blendDst = GL_ZERO;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	// GLStateCache sets the color and alpha factors together
+	glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+	glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+	const GLenum caps[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+	bool enabled[3];
+	for (int i = 0; i < 3; ++i) {
+		enabled[i] = glIsEnabled(caps[i]) == GL_TRUE;
+	}
+
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	state.viewport(0, 0, 1, 1);
+	// anything queued before must not be billed to the first draw
+	glFinish();
+	for (const auto& entry : m_pending) {
+		applyState(entry.state);
+		entry.shader->flush();
+		entry.shader->use();
+		state.bindVertexArray(entry.vao);
+		PrewarmResult result;
+		result.shader = entry.shader;
+		result.vao = entry.vao;
+		result.firstDrawMs = timedDraw(entry.mode, entry.vertexCount);
+		result.warmDrawMs = timedDraw(entry.mode, entry.vertexCount);
+		auto telemetry = entry.shader->m_telemetry;
+		if (telemetry && telemetry->firstDrawMs < 0.0) {
+			telemetry->firstDrawMs = result.firstDrawMs;
+		}
+		m_results.push_back(result);
+	}
+	auto count = m_pending.size();
+	m_pending.clear();
+
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	state.viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	for (int i = 0; i < 3; ++i) {
+		state.setEnabled(caps[i], enabled[i]);
+	}
+	state.blendFunc(blendSrc, blendDst);
+	state.bindVertexArray(vao);
+	return count;
+}
+
+void ShaderPrewarmer::printReport() const
+{
+	double total = 0.0;
+	for (const auto& result : m_results) {
+		printf("shader prewarm: program %u, vao %u: first draw %.3f ms, warm draw %.3f ms, hitch %.3f ms\n",
+			result.shader->program(), result.vao, result.firstDrawMs, result.warmDrawMs, result.hitchMs());
+		total += result.hitchMs();
+	}
+	printf("shader prewarm: %u draws, %.3f ms of hitches moved to loading\n",
+		static_cast<unsigned>(m_results.size()), total);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+class Shader;
+
+// Fixed-function state a program is drawn with; drivers may compile a separate
+// variant for each combination.
+struct PrewarmState {
+	bool depthTest = true;
+	bool blend = false;
+	bool cullFace = false;
+	GLenum blendSrc = GL_SRC_ALPHA;
+	GLenum blendDst = GL_ONE_MINUS_SRC_ALPHA;
+};
+
+struct PrewarmResult {
+	Shader* shader;
+	GLuint vao;
+	double firstDrawMs;	// the draw that paid for code generation
+	double warmDrawMs;	// the same draw repeated
+	double hitchMs() const { return firstDrawMs > warmDrawMs ? firstDrawMs - warmDrawMs : 0.0; }
+};
+
+// Drivers (Mesa among them) defer the final code generation of a program until it
+// is first drawn with a given vertex format and state, which stalls the frame the
+// material first appears in. The prewarmer draws every registered combination once
+// into a 1x1 framebuffer during loading, timing the first and a repeated draw with
+// glFinish so the report shows the hitch moved out of the frame loop. The first
+// draw of a program is also recorded as its ShaderTelemetry firstDrawMs.
+// The framebuffer formats should match the ones the programs render to later.
+class ShaderPrewarmer {
+public:
+	explicit ShaderPrewarmer(GLenum colorFormat = GL_RGBA8, GLenum depthFormat = GL_DEPTH24_STENCIL8);
+	~ShaderPrewarmer();
+	ShaderPrewarmer(const ShaderPrewarmer&) = delete;
+	ShaderPrewarmer& operator=(const ShaderPrewarmer&) = delete;
+
+	// The VAO must provide at least vertexCount vertices for glDrawArrays.
+	void add(Shader& shader, GLuint vao, const PrewarmState& state = PrewarmState(),
+		GLenum mode = GL_TRIANGLES, GLsizei vertexCount = 3);
+	// Draws every combination added since the last run. Restores the framebuffer,
+	// viewport, blend function and the capabilities it touched. Returns the number
+	// of draws.
+	size_t run();
+
+	const std::vector<PrewarmResult>& results() const { return m_results; }
+	void printReport() const;
+
+private:
+	struct Entry {
+		Shader* shader;
+		GLuint vao;
+		PrewarmState state;
+		GLenum mode;
+		GLsizei vertexCount;
+	};
+
+	void applyState(const PrewarmState& state);
+
+private:
+	GLuint m_framebuffer = 0;
+	GLuint m_renderbuffers[2] = {};
+	std::vector<Entry> m_pending;
+	std::vector<PrewarmResult> m_results;
+};
@@ -0,0 +1,337 @@
+#include "shader_reloader.h"
+#include "shader.h"
+#include "program_binary_cache.h"
+#include "shader_stage_cache.h"
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::filesystem::file_time_type modifiedTime(const std::string& file)
+{
+	std::error_code ec;
+	auto time = std::filesystem::last_write_time(file, ec);
+	return ec ? std::filesystem::file_time_type::min() : time;
+}
+
+bool shaderStatus(GLuint object, GLenum pname, std::string& log, bool program)
+{
+	GLint success = GL_FALSE;
+	GLint length = 0;
+	if (program) {
+		glGetProgramiv(object, pname, &success);
+		glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+	} else {
+		glGetShaderiv(object, pname, &success);
+		glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+	}
+	if (!success && length > 0) {
+		std::string message(length, '\0');
+		if (program) {
+			glGetProgramInfoLog(object, length, nullptr, message.data());
+		} else {
+			glGetShaderInfoLog(object, length, nullptr, message.data());
+		}
+		log.append(message.c_str());
+	}
+	return success == GL_TRUE;
+}
+
+}
+
+ShaderReloader::ShaderReloader(WorkerContext workerContext)
+	:m_workerContext(std::move(workerContext))
+{
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	m_running = true;
+	m_thread = std::thread(&ShaderReloader::run, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	m_running = false;
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+#ifdef __linux__
+	if (m_inotify >= 0) {
+		close(m_inotify);
+	}
+#endif
+	for (const auto& result : m_results) {
+		glDeleteSync(result.fence);
+		glDeleteProgram(result.program);
+	}
+}
+
+bool ShaderReloader::watch(Shader& shader)
+{
+	Watched watched;
+	watched.shader = &shader;
+	watched.separable = shader.isSeparable();
+	watched.sources = shader.sources();
+	for (const auto& pair : watched.sources) {
+		for (const auto& file : pair.second->files()) {
+			watched.dependencies.insert(file);
+		}
+	}
+	if (watched.dependencies.empty()) {
+		std::cout << "shader reloader: program " << shader.program() << " has no stage loaded from a file, not watched\n";
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const auto& file : watched.dependencies) {
+		addWatch(file);
+	}
+	m_watched.push_back(std::move(watched));
+	return true;
+}
+
+void ShaderReloader::unwatch(Shader& shader)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_watched.erase(std::remove_if(m_watched.begin(), m_watched.end(),
+		[&shader](const Watched& watched) { return watched.shader == &shader; }), m_watched.end());
+	for (auto it = m_results.begin(); it != m_results.end();) {
+		if (it->shader == &shader) {
+			glDeleteSync(it->fence);
+			glDeleteProgram(it->program);
+			it = m_results.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void ShaderReloader::addWatch(const std::string& file)
+{
+	m_modified[file] = modifiedTime(file);
+#ifdef __linux__
+	if (m_inotify < 0) {
+		return;
+	}
+	// watch the directory: editors often save by renaming a new file over the old one
+	auto directory = std::filesystem::path(file).parent_path().string();
+	for (const auto& pair : m_watchDirs) {
+		if (pair.second == directory) {
+			return;
+		}
+	}
+	auto wd = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd >= 0) {
+		m_watchDirs[wd] = directory;
+	}
+#endif
+}
+
+bool ShaderReloader::collectChanges(std::set<std::string>& changed, std::chrono::milliseconds timeout)
+{
+	size_t before = changed.size();
+#ifdef __linux__
+	if (m_inotify >= 0) {
+		pollfd fd = { m_inotify, POLLIN, 0 };
+		if (poll(&fd, 1, static_cast<int>(timeout.count())) <= 0) {
+			return false;
+		}
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (char* ptr = buffer; ptr < buffer + length;) {
+				auto event = reinterpret_cast<inotify_event*>(ptr);
+				auto dir = m_watchDirs.find(event->wd);
+				if (dir != m_watchDirs.end() && event->len) {
+					auto path = (std::filesystem::path(dir->second) / event->name).string();
+					if (m_modified.count(path)) {
+						changed.insert(path);
+					}
+				}
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+		return changed.size() != before;
+	}
+#endif
+	std::this_thread::sleep_for(timeout);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& pair : m_modified) {
+		auto time = modifiedTime(pair.first);
+		if (time != pair.second) {
+			pair.second = time;
+			changed.insert(pair.first);
+		}
+	}
+	return changed.size() != before;
+}
+
+void ShaderReloader::run()
+{
+	if (!m_workerContext.bind || !m_workerContext.bind()) {
+		std::cout << "shader reloader: no worker context, hot reload disabled\n";
+		return;
+	}
+	std::set<std::string> changed;
+	while (m_running) {
+		if (!collectChanges(changed, std::chrono::milliseconds(100))) {
+			continue;
+		}
+		// editors save in several steps; wait until the files settle
+		while (m_running && collectChanges(changed, std::chrono::milliseconds(50))) {
+		}
+		rebuild(changed);
+		changed.clear();
+	}
+	if (m_workerContext.release) {
+		m_workerContext.release();
+	}
+}
+
+void ShaderReloader::rebuild(const std::set<std::string>& changed)
+{
+	std::vector<Watched> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const auto& watched : m_watched) {
+			bool affected = std::any_of(watched.dependencies.begin(), watched.dependencies.end(),
+				[&changed](const std::string& file) { return changed.count(file) != 0; });
+			if (affected) {
+				jobs.push_back(watched);
+			}
+		}
+	}
+	for (const auto& job : jobs) {
+		std::string log;
+		auto result = build(job, log);
+		auto program = result.program;
+		if (!program) {
+			++m_failures;
+			std::cout << "shader reload failed, keeping the old program:\n" << log << "\n";
+			continue;
+		}
+		// the render context waits on this fence, so it must reach the GPU
+		auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto watched = std::find_if(m_watched.begin(), m_watched.end(),
+			[&job](const Watched& watched) { return watched.shader == job.shader; });
+		if (watched != m_watched.end()) {
+			// includes may have been added or removed by the edit
+			for (const auto& file : result.dependencies) {
+				if (!m_modified.count(file)) {
+					addWatch(file);
+				}
+			}
+			watched->dependencies = std::move(result.dependencies);
+			watched->sources = result.sources;
+			m_results.push_back({ job.shader, program, fence, std::move(result.sources) });
+		} else {
+			glDeleteSync(fence);
+			glDeleteProgram(program);
+		}
+	}
+}
+
+ShaderReloader::Build ShaderReloader::build(const Watched& job, std::string& log)
+{
+	Build result;
+	for (const auto& pair : job.sources) {
+		auto source = ShaderSourceCache::shared().reload(pair.second, &log);
+		if (!source) {
+			return result;
+		}
+		result.dependencies.insert(source->files().begin(), source->files().end());
+		result.sources[pair.first] = std::move(source);
+	}
+
+	auto program = glCreateProgram();
+	if (job.separable) {
+		glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	}
+	auto binaryCache = Shader::binaryCache();
+	uint64_t binaryKey = 0;
+	if (binaryCache && binaryCache->isSupported()) {
+		binaryKey = Shader::binaryKey(result.sources, job.separable);
+		if (binaryCache->load(program, binaryKey)) {
+			result.program = program;
+			return result;
+		}
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	} else {
+		binaryCache = nullptr;
+	}
+	auto stageCache = Shader::stageCache();
+	std::vector<GLuint> shaders;
+	bool success = true;
+	for (const auto& pair : result.sources) {
+		GLuint shader;
+		if (stageCache) {
+			shader = stageCache->acquire(pair.first, *pair.second);
+		} else {
+			shader = glCreateShader(pair.first);
+			glShaderSource(shader, pair.second->count(), pair.second->strings(), pair.second->lengths());
+			glCompileShader(shader);
+		}
+		glAttachShader(program, shader);
+		shaders.push_back(shader);
+		std::string stageLog;
+		if (!shaderStatus(shader, GL_COMPILE_STATUS, stageLog, false)) {
+			log = pair.second->mapLog(stageLog);
+			success = false;
+			break;
+		}
+	}
+	if (success) {
+		glLinkProgram(program);
+		success = shaderStatus(program, GL_LINK_STATUS, log, true);
+	}
+	for (auto shader : shaders) {
+		glDetachShader(program, shader);
+		if (stageCache) {
+			stageCache->release(shader);
+		} else {
+			glDeleteShader(shader);
+		}
+	}
+	if (!success) {
+		glDeleteProgram(program);
+		return result;
+	}
+	if (binaryCache) {
+		binaryCache->store(program, binaryKey);
+	}
+	result.program = program;
+	return result;
+}
+
+size_t ShaderReloader::applyPending()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t applied = 0;
+	for (auto it = m_results.begin(); it != m_results.end();) {
+		auto status = glClientWaitSync(it->fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			++it;
+			continue;
+		}
+		glDeleteSync(it->fence);
+		it->shader->replaceProgram(it->program, std::move(it->sources));
+		++m_reloads;
+		++applied;
+		it = m_results.erase(it);
+	}
+	// the replaced programs' stages are unreferenced now; without this every save
+	// would leave one compiled shader object per stage behind
+	auto stageCache = Shader::stageCache();
+	if (applied && stageCache) {
+		stageCache->trim();
+	}
+	return applied;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <glad/glad.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shader_source.h"
+
+class Shader;
+
+// Watches the files the stages of Shaders were loaded from, including the files
+// they #include, and rebuilds a program in the background when one of them
+// changes. Every stage is rebuilt from its ShaderSource: file stages are loaded
+// again with the same defines injected, string stages are reused as they are.
+// Rebuilds go through the installed ShaderStageCache and ProgramBinaryCache and
+// run on a worker thread with its own GL context sharing objects with the render
+// context; the render thread swaps finished programs in with applyPending() at a
+// frame boundary and never waits for a compile. A program that fails to build is
+// reported and the old one is kept.
+// Changes are picked up through inotify on Linux and by polling modification
+// times elsewhere.
+class ShaderReloader {
+public:
+	// Called on the worker thread. bind runs once when it starts and must make
+	// current a context that shares objects with the render context (e.g. a hidden
+	// GLFW window created with the render window as its share); release, if set,
+	// runs before it exits so the context is current nowhere when it is destroyed.
+	struct WorkerContext {
+		std::function<bool()> bind;
+		std::function<void()> release;
+	};
+
+	explicit ShaderReloader(WorkerContext workerContext);
+	~ShaderReloader();
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	// Returns false and says why if the shader has no stage loaded from a file.
+	bool watch(Shader& shader);
+	// Must be called before a watched Shader is destroyed.
+	void unwatch(Shader& shader);
+
+	// Render thread, once per frame: replaces the program of every Shader whose
+	// rebuild has finished on the GPU, then trims the installed ShaderStageCache.
+	// Returns the number of programs swapped.
+	size_t applyPending();
+
+	uint32_t reloadCount() const { return m_reloads; }
+	uint32_t failureCount() const { return m_failures; }
+
+private:
+	struct Watched {
+		Shader* shader;
+		bool separable;
+		std::map<GLenum, ShaderSourcePtr> sources;
+		std::set<std::string> dependencies;	// files plus everything they include
+	};
+
+	struct Result {
+		Shader* shader;
+		GLuint program;
+		GLsync fence;
+		std::map<GLenum, ShaderSourcePtr> sources;
+	};
+
+	struct Build {
+		GLuint program = 0;
+		std::map<GLenum, ShaderSourcePtr> sources;
+		std::set<std::string> dependencies;
+	};
+
+	void run();
+	void addWatch(const std::string& file);
+	// Waits up to timeout for file changes and adds the changed paths; returns
+	// false if nothing changed.
+	bool collectChanges(std::set<std::string>& changed, std::chrono::milliseconds timeout);
+	void rebuild(const std::set<std::string>& changed);
+	Build build(const Watched& job, std::string& log);
+
+private:
+	WorkerContext m_workerContext;
+	std::mutex m_mutex;
+	std::vector<Watched> m_watched;
+	std::vector<Result> m_results;
+	std::map<std::string, std::filesystem::file_time_type> m_modified;	// polling fallback
+	std::map<int, std::string> m_watchDirs;	// inotify watch descriptor -> directory
+	int m_inotify = -1;
+	std::atomic<bool> m_running { false };
+	std::atomic<uint32_t> m_reloads { 0 };
+	std::atomic<uint32_t> m_failures { 0 };
+	std::thread m_thread;
+};
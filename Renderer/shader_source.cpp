@@ -0,0 +1,541 @@
+#include "shader_source.h"
+#include "hash.h"
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void reportError(std::string* log, const std::string& message)
+{
+	if (log) {
+		*log = message;
+	} else {
+		std::cout << message;
+	}
+}
+
+std::string normalizePath(const std::string& path)
+{
+	std::error_code ec;
+	auto absolute = std::filesystem::absolute(path, ec);
+	return (ec ? std::filesystem::path(path) : absolute).lexically_normal().string();
+}
+
+const char* skipSpace(const char* it, const char* end)
+{
+	while (it < end && (*it == ' ' || *it == '\t' || *it == '\r')) {
+		++it;
+	}
+	return it;
+}
+
+std::string_view directiveWord(const char*& it, const char* end)
+{
+	auto begin = it;
+	while (it < end && (std::isalnum(static_cast<unsigned char>(*it)) || *it == '_')) {
+		++it;
+	}
+	return std::string_view(begin, it - begin);
+}
+
+enum class Directive {
+	None,
+	Include,
+	PragmaOnce,
+};
+
+// Recognizes #include "name", #include <name> and #pragma once on one line.
+Directive parseDirective(const char* it, const char* end, std::string& name, bool& quoted)
+{
+	it = skipSpace(it, end);
+	if (it == end || *it != '#') {
+		return Directive::None;
+	}
+	it = skipSpace(it + 1, end);
+	auto word = directiveWord(it, end);
+	it = skipSpace(it, end);
+	if (word == "pragma") {
+		return directiveWord(it, end) == "once" ? Directive::PragmaOnce : Directive::None;
+	}
+	if (word != "include" || it == end || (*it != '"' && *it != '<')) {
+		return Directive::None;
+	}
+	quoted = *it == '"';
+	auto close = static_cast<const char*>(memchr(it + 1, quoted ? '"' : '>', end - it - 1));
+	if (!close) {
+		return Directive::None;
+	}
+	name.assign(it + 1, close);
+	return Directive::Include;
+}
+
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path, std::string* log)
+{
+	std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+	auto handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		reportError(log, "open file failed !");
+		return nullptr;
+	}
+	file->m_file = handle;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size)) {
+		reportError(log, "open file failed !");
+		return nullptr;
+	}
+	file->m_size = static_cast<size_t>(size.QuadPart);
+	if (!file->m_size) {
+		return file;
+	}
+	if (file->m_size <= COPY_LIMIT) {
+		file->m_copy.resize(file->m_size);
+		DWORD read = 0;
+		if (!ReadFile(handle, file->m_copy.data(), static_cast<DWORD>(file->m_size), &read, nullptr)) {
+			reportError(log, "read file failed !");
+			return nullptr;
+		}
+		// the file may have shrunk since its size was read
+		file->m_copy.resize(read);
+		file->m_size = read;
+		file->m_data = file->m_copy.data();
+		return file;
+	}
+	file->m_mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!file->m_mapping) {
+		reportError(log, "map file failed !");
+		return nullptr;
+	}
+	file->m_data = static_cast<const char*>(MapViewOfFile(file->m_mapping, FILE_MAP_READ, 0, 0, 0));
+	file->m_mapped = file->m_data != nullptr;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		reportError(log, "open file failed !");
+		return nullptr;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		reportError(log, "open file failed !");
+		return nullptr;
+	}
+	file->m_size = static_cast<size_t>(info.st_size);
+	if (file->m_size && file->m_size <= COPY_LIMIT) {
+		file->m_copy.resize(file->m_size);
+		size_t total = 0;
+		while (total < file->m_size) {
+			auto count = ::read(fd, file->m_copy.data() + total, file->m_size - total);
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+			if (count < 0) {
+				::close(fd);
+				reportError(log, "read file failed !");
+				return nullptr;
+			}
+			if (count == 0) {
+				// the file shrank since its size was read
+				break;
+			}
+			total += static_cast<size_t>(count);
+		}
+		file->m_copy.resize(total);
+		file->m_size = total;
+		file->m_data = file->m_copy.data();
+	} else if (file->m_size) {
+		auto data = mmap(nullptr, file->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		file->m_data = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+		file->m_mapped = file->m_data != nullptr;
+	}
+	// a mapping keeps the file referenced
+	::close(fd);
+#endif
+	if (file->m_size && !file->m_data) {
+		file->m_size = 0;
+		reportError(log, "map file failed !");
+		return nullptr;
+	}
+	return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (m_mapped) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file) {
+		CloseHandle(m_file);
+	}
+#else
+	if (m_mapped) {
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+#endif
+}
+
+ShaderSourcePtr ShaderSource::fromString(std::string source)
+{
+	auto result = std::make_shared<ShaderSource>();
+	result->appendText(std::move(source));
+	result->finish();
+	return result;
+}
+
+ShaderSourcePtr ShaderSource::insertAfterVersion(const ShaderSource& source, const std::string& text)
+{
+	// the text goes right after #version, which must stay the first directive
+	size_t chunk = 0;
+	size_t split = 0;
+	size_t versionLine = 0;
+	for (size_t i = 0; i < source.m_strings.size(); ++i) {
+		std::string_view view(source.m_strings[i], source.m_lengths[i]);
+		auto version = view.find("#version");
+		if (version == std::string_view::npos) {
+			continue;
+		}
+		auto lineEnd = view.find('\n', version);
+		chunk = i;
+		split = lineEnd == std::string_view::npos ? view.size() : lineEnd + 1;
+		for (size_t j = 0; j < i; ++j) {
+			versionLine += std::count(source.m_strings[j], source.m_strings[j] + source.m_lengths[j], '\n');
+		}
+		versionLine += std::count(view.begin(), view.begin() + split, '\n');
+		break;
+	}
+
+	auto result = std::make_shared<ShaderSource>();
+	result->m_mappings = source.m_mappings;
+	result->m_text = source.m_text;
+	result->m_files = source.m_files;
+	result->m_insertions = source.m_insertions;
+	result->m_insertions.push_back(text);
+	for (size_t i = 0; i < chunk; ++i) {
+		result->append(source.m_strings[i], source.m_lengths[i]);
+	}
+	std::string injected;
+	if (!source.m_strings.empty()) {
+		result->append(source.m_strings[chunk], split);
+		if (split > 0 && source.m_strings[chunk][split - 1] != '\n') {
+			injected += '\n';
+		}
+	}
+	injected += text;
+	// keep compiler messages pointing at the lines of the original source
+	injected += "#line " + std::to_string(versionLine + 1) + "\n";
+	result->appendText(std::move(injected));
+	for (size_t i = chunk; i < source.m_strings.size(); ++i) {
+		auto offset = i == chunk ? split : 0;
+		result->append(source.m_strings[i] + offset, source.m_lengths[i] - offset);
+	}
+	result->finish();
+	return result;
+}
+
+int ShaderSource::addFile(const std::string& path)
+{
+	auto it = std::find(m_files.begin(), m_files.end(), path);
+	if (it != m_files.end()) {
+		return static_cast<int>(it - m_files.begin());
+	}
+	m_files.push_back(path);
+	return static_cast<int>(m_files.size() - 1);
+}
+
+void ShaderSource::append(const char* data, size_t length)
+{
+	if (length) {
+		m_strings.push_back(data);
+		m_lengths.push_back(static_cast<GLint>(length));
+	}
+}
+
+void ShaderSource::appendText(std::string text)
+{
+	auto stored = std::make_shared<const std::string>(std::move(text));
+	append(stored->data(), stored->size());
+	m_text.push_back(std::move(stored));
+}
+
+void ShaderSource::finish()
+{
+	m_size = 0;
+	m_hash = FNV1A_OFFSET_BASIS;
+	for (size_t i = 0; i < m_strings.size(); ++i) {
+		m_size += m_lengths[i];
+		m_hash = fnv1a(m_strings[i], m_lengths[i], m_hash);
+	}
+}
+
+std::string ShaderSource::str() const
+{
+	std::string result;
+	result.reserve(m_size);
+	for (size_t i = 0; i < m_strings.size(); ++i) {
+		result.append(m_strings[i], m_lengths[i]);
+	}
+	return result;
+}
+
+std::string ShaderSource::mapLog(const std::string& log) const
+{
+	if (m_files.empty()) {
+		return log;
+	}
+	// "0(12) : error" (NVIDIA), "0:12(5): error" (Mesa) and "ERROR: 0:12:" (AMD); only
+	// the source string number leading a message is replaced, never line or column
+	std::string result;
+	result.reserve(log.size());
+	for (size_t lineStart = 0; lineStart < log.size();) {
+		auto lineEnd = log.find('\n', lineStart);
+		lineEnd = lineEnd == std::string::npos ? log.size() : lineEnd + 1;
+		std::string_view line(log.data() + lineStart, lineEnd - lineStart);
+		lineStart = lineEnd;
+
+		size_t begin = line.find_first_not_of(" \t");
+		begin = begin == std::string_view::npos ? line.size() : begin;
+		for (std::string_view prefix : { "ERROR:", "WARNING:" }) {
+			if (line.compare(begin, prefix.size(), prefix) == 0) {
+				begin = line.find_first_not_of(" \t", begin + prefix.size());
+				begin = begin == std::string_view::npos ? line.size() : begin;
+				break;
+			}
+		}
+		unsigned long index = 0;
+		auto first = line.data() + begin;
+		auto last = line.data() + line.size();
+		auto parsed = std::from_chars(first, last, index);
+		bool location = parsed.ec == std::errc() && parsed.ptr + 1 < last
+			&& (*parsed.ptr == ':' || *parsed.ptr == '(')
+			&& std::isdigit(static_cast<unsigned char>(parsed.ptr[1]));
+		if (!location || index >= m_files.size()) {
+			result += line;
+			continue;
+		}
+		result += line.substr(0, begin);
+		result += m_files[index];
+		result += std::string_view(parsed.ptr, last - parsed.ptr);
+	}
+	return result;
+}
+
+ShaderSourceCache& ShaderSourceCache::shared()
+{
+	static ShaderSourceCache cache;
+	return cache;
+}
+
+void ShaderSourceCache::addIncludeDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_includeDirs.push_back(normalizePath(directory));
+	// includes may resolve differently now
+	m_expanded.clear();
+}
+
+void ShaderSourceCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_files.clear();
+	m_expanded.clear();
+}
+
+ShaderSourceCacheStats ShaderSourceCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void ShaderSourceCache::printStats() const
+{
+	auto current = stats();
+	printf("shader source cache: %u files read, %u sources expanded, %u hits\n",
+		current.reads, current.expansions, current.hits);
+}
+
+ShaderSourcePtr ShaderSourceCache::load(const std::string& path, std::string* log)
+{
+	auto key = normalizePath(path);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_expanded.find(key);
+	if (it != m_expanded.end()) {
+		bool upToDate = true;
+		for (const auto& dependency : it->second.dependencies) {
+			std::error_code ec;
+			if (std::filesystem::last_write_time(dependency.first, ec) != dependency.second || ec) {
+				upToDate = false;
+				break;
+			}
+		}
+		if (upToDate) {
+			++m_stats.hits;
+			return it->second.source;
+		}
+		m_expanded.erase(it);
+	}
+
+	Expansion expansion;
+	if (!expand(key, expansion, log)) {
+		return nullptr;
+	}
+	expansion.source.finish();
+	if (!expansion.source.size()) {
+		reportError(log, "file content empty !");
+		return nullptr;
+	}
+	++m_stats.expansions;
+	auto source = std::make_shared<const ShaderSource>(std::move(expansion.source));
+	m_expanded[key] = { source, std::move(expansion.dependencies) };
+	return source;
+}
+
+ShaderSourcePtr ShaderSourceCache::reload(const ShaderSourcePtr& source, std::string* log)
+{
+	if (source->files().empty()) {
+		return source;
+	}
+	auto result = load(source->files().front(), log);
+	for (const auto& text : source->insertions()) {
+		if (!result) {
+			break;
+		}
+		result = ShaderSource::insertAfterVersion(*result, text);
+	}
+	return result;
+}
+
+std::shared_ptr<const MappedFile> ShaderSourceCache::mapFile(const std::string& path, std::filesystem::file_time_type& modified, std::string* log)
+{
+	std::error_code ec;
+	modified = std::filesystem::last_write_time(path, ec);
+	if (ec) {
+		reportError(log, "file not exist !");
+		return nullptr;
+	}
+	auto it = m_files.find(path);
+	if (it != m_files.end() && it->second.modified == modified) {
+		return it->second.file;
+	}
+	auto file = MappedFile::open(path, log);
+	if (!file) {
+		return nullptr;
+	}
+	++m_stats.reads;
+	m_files[path] = { modified, file };
+	return file;
+}
+
+std::string ShaderSourceCache::resolve(const std::string& name, bool quoted, const std::string& includer) const
+{
+	std::error_code ec;
+	if (quoted) {
+		auto candidate = std::filesystem::path(includer).parent_path() / name;
+		if (std::filesystem::is_regular_file(candidate, ec)) {
+			return normalizePath(candidate.string());
+		}
+	}
+	for (const auto& directory : m_includeDirs) {
+		auto candidate = std::filesystem::path(directory) / name;
+		if (std::filesystem::is_regular_file(candidate, ec)) {
+			return normalizePath(candidate.string());
+		}
+	}
+	return std::string();
+}
+
+bool ShaderSourceCache::expand(const std::string& path, Expansion& expansion, std::string* log)
+{
+	std::filesystem::file_time_type modified;
+	auto file = mapFile(path, modified, log);
+	if (!file) {
+		if (log) {
+			*log = path + ": " + *log;
+		}
+		return false;
+	}
+	auto& source = expansion.source;
+	auto index = source.addFile(path);
+	if (static_cast<size_t>(index) == expansion.dependencies.size()) {
+		expansion.dependencies.emplace_back(path, modified);
+		source.m_mappings.push_back(file);
+	}
+	expansion.stack.push_back(path);
+
+	auto data = file->data();
+	auto end = data + file->size();
+	auto chunkBegin = data;
+	size_t line = 1;
+	std::string name;
+	bool quoted = false;
+	for (auto it = data; it < end; ++line) {
+		auto lineEnd = static_cast<const char*>(memchr(it, '\n', end - it));
+		auto next = lineEnd ? lineEnd + 1 : end;
+		lineEnd = lineEnd ? lineEnd : end;
+		auto directive = parseDirective(it, lineEnd, name, quoted);
+		if (directive == Directive::None) {
+			it = next;
+			continue;
+		}
+		source.append(chunkBegin, it - chunkBegin);
+		chunkBegin = next;
+		if (directive == Directive::PragmaOnce) {
+			expansion.once.insert(path);
+			source.appendText("\n");
+			it = next;
+			continue;
+		}
+
+		auto included = resolve(name, quoted, path);
+		if (included.empty()) {
+			reportError(log, path + "(" + std::to_string(line) + "): include file not found: " + name + "\n");
+			return false;
+		}
+		if (std::find(expansion.stack.begin(), expansion.stack.end(), included) != expansion.stack.end()) {
+			reportError(log, path + "(" + std::to_string(line) + "): recursive include of " + included + "\n");
+			return false;
+		}
+		if (expansion.once.count(included)) {
+			source.appendText("\n");
+			it = next;
+			continue;
+		}
+		auto includedIndex = source.addFile(included);
+		source.appendText("#line 1 " + std::to_string(includedIndex) + "\n");
+		if (!expand(included, expansion, log)) {
+			return false;
+		}
+		std::string resume = "#line " + std::to_string(line + 1) + " " + std::to_string(index) + "\n";
+		if (!source.m_strings.empty() && source.m_strings.back()[source.m_lengths.back() - 1] != '\n') {
+			resume.insert(resume.begin(), '\n');
+		}
+		source.appendText(std::move(resume));
+		it = next;
+	}
+	source.append(chunkBegin, end - chunkBegin);
+	expansion.stack.pop_back();
+	return true;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Read-only snapshot of a whole file. Files up to COPY_LIMIT, which covers any
+// shader, are read into an owned buffer, so rewriting the file later cannot change
+// the bytes a ShaderSource hashed. Larger files are memory-mapped where the platform
+// allows it: replacing one by rename keeps the old mapping valid, but writing it in
+// place shows the new bytes under the old hash, and truncating it makes reads past
+// the new end fault. ShaderSourceCache loads a file again when its modification
+// time changes either way.
+class MappedFile {
+public:
+	static const size_t COPY_LIMIT = 1 << 20;
+
+	static std::shared_ptr<const MappedFile> open(const std::string& path, std::string* log = nullptr);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	MappedFile() = default;
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	std::vector<char> m_copy;	// backs m_data unless it is mapped
+	bool m_mapped = false;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
+
+class ShaderSource;
+using ShaderSourcePtr = std::shared_ptr<const ShaderSource>;
+
+// Stage source as a list of strings handed to glShaderSource as pointer/length
+// arrays. File contents are referenced in place, so expanding includes copies
+// nothing but the generated #line directives.
+// files() lists the files the source was expanded from; the position of a file is
+// its source string number in #line directives and compiler messages. The first is
+// the file the source was loaded from; a source built from a string has none.
+class ShaderSource {
+public:
+	static ShaderSourcePtr fromString(std::string source);
+	// Copy of source with text inserted after the #version line, followed by a #line
+	// directive so compiler messages keep pointing at the original lines.
+	static ShaderSourcePtr insertAfterVersion(const ShaderSource& source, const std::string& text);
+
+	GLsizei count() const { return static_cast<GLsizei>(m_strings.size()); }
+	const GLchar* const* strings() const { return m_strings.data(); }
+	const GLint* lengths() const { return m_lengths.data(); }
+	size_t size() const { return m_size; }
+	uint64_t hash() const { return m_hash; }
+	const std::vector<std::string>& files() const { return m_files; }
+	// Texts inserted with insertAfterVersion(), oldest first.
+	const std::vector<std::string>& insertions() const { return m_insertions; }
+
+	std::string str() const;
+	// Replaces the source string numbers in a compiler log by file names.
+	std::string mapLog(const std::string& log) const;
+
+private:
+	friend class ShaderSourceCache;
+
+	int addFile(const std::string& path);
+	void append(const char* data, size_t length);
+	void appendText(std::string text);
+	void finish();
+
+private:
+	std::vector<const GLchar*> m_strings;
+	std::vector<GLint> m_lengths;
+	// keep the referenced memory alive; shared so copies stay valid
+	std::vector<std::shared_ptr<const MappedFile>> m_mappings;
+	std::vector<std::shared_ptr<const std::string>> m_text;
+	std::vector<std::string> m_files;
+	std::vector<std::string> m_insertions;
+	size_t m_size = 0;
+	uint64_t m_hash = 0;
+};
+
+struct ShaderSourceCacheStats {
+	uint32_t reads = 0;	// files mapped
+	uint32_t expansions = 0;	// sources expanded
+	uint32_t hits = 0;	// loads answered from the cache
+};
+
+// Loads shader files and resolves #include "file" (relative to the including file,
+// then the include directories) and #include <file> (include directories only).
+// "#pragma once" skips later includes of the same file within one source; classic
+// #ifndef guards are left to the GLSL preprocessor. Included cycles are an error.
+// Files are mapped once per modification time and expanded sources are cached
+// until one of their files changes, so a library sharing heavy includes reads each
+// file once. Thread safe; ShaderReloader loads through it from its worker thread.
+class ShaderSourceCache {
+public:
+	static ShaderSourceCache& shared();
+
+	void addIncludeDirectory(const std::string& directory);
+	// Returns nullptr and fills log if a file is missing, empty or included recursively.
+	ShaderSourcePtr load(const std::string& path, std::string* log = nullptr);
+	// Loads source again from its first file and inserts the same texts after #version,
+	// so a variant stays the same variant. A source without files is returned as is.
+	ShaderSourcePtr reload(const ShaderSourcePtr& source, std::string* log = nullptr);
+	void clear();
+
+	ShaderSourceCacheStats stats() const;
+	void printStats() const;
+
+private:
+	struct MappedEntry {
+		std::filesystem::file_time_type modified;
+		std::shared_ptr<const MappedFile> file;
+	};
+
+	struct ExpandedEntry {
+		ShaderSourcePtr source;
+		std::vector<std::pair<std::string, std::filesystem::file_time_type>> dependencies;
+	};
+
+	struct Expansion {
+		ShaderSource source;
+		std::vector<std::string> stack;
+		std::set<std::string> once;
+		std::vector<std::pair<std::string, std::filesystem::file_time_type>> dependencies;
+	};
+
+	std::shared_ptr<const MappedFile> mapFile(const std::string& path, std::filesystem::file_time_type& modified, std::string* log);
+	bool expand(const std::string& path, Expansion& expansion, std::string* log);
+	std::string resolve(const std::string& name, bool quoted, const std::string& includer) const;
+
+private:
+	mutable std::mutex m_mutex;
+	std::vector<std::string> m_includeDirs;
+	std::map<std::string, MappedEntry> m_files;
+	std::map<std::string, ExpandedEntry> m_expanded;
+	ShaderSourceCacheStats m_stats;
+};
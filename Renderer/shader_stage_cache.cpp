@@ -0,0 +1,83 @@
+#include "shader_stage_cache.h"
+#include "hash.h"
+#include <cstdio>
+
+ShaderStageCache::~ShaderStageCache()
+{
+	for (const auto& pair : m_entries) {
+		glDeleteShader(pair.second.shader);
+	}
+}
+
+GLuint ShaderStageCache::acquire(GLenum shaderType, const ShaderSource& source, bool* hit)
+{
+	auto key = fnv1a(reinterpret_cast<const char*>(&shaderType), sizeof(shaderType));
+	auto sourceHash = source.hash();
+	key = fnv1a(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash), key);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (hit) {
+		*hit = it != m_entries.end();
+	}
+	if (it != m_entries.end()) {
+		++m_stats.hits;
+		++it->second.references;
+		return it->second.shader;
+	}
+	++m_stats.misses;
+	Entry entry;
+	entry.shader = glCreateShader(shaderType);
+	entry.references = 1;
+	glShaderSource(entry.shader, source.count(), source.strings(), source.lengths());
+	glCompileShader(entry.shader);
+	m_entries[key] = entry;
+	m_keys[entry.shader] = key;
+	return entry.shader;
+}
+
+void ShaderStageCache::release(GLuint shader)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_keys.find(shader);
+	if (it == m_keys.end()) {
+		return;
+	}
+	auto& entry = m_entries[it->second];
+	if (entry.references) {
+		--entry.references;
+	}
+}
+
+void ShaderStageCache::trim()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto it = m_entries.begin(); it != m_entries.end();) {
+		if (it->second.references) {
+			++it;
+			continue;
+		}
+		glDeleteShader(it->second.shader);
+		m_keys.erase(it->second.shader);
+		it = m_entries.erase(it);
+		++m_stats.trimmed;
+	}
+}
+
+size_t ShaderStageCache::size() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+ShaderStageCacheStats ShaderStageCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void ShaderStageCache::printStats() const
+{
+	auto current = stats();
+	printf("shader stage cache: %u hits, %u misses, %u cached, %u trimmed\n",
+		current.hits, current.misses, static_cast<unsigned>(size()), current.trimmed);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "shader_source.h"
+
+struct ShaderStageCacheStats {
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	uint32_t trimmed = 0;
+};
+
+// Content-addressed cache of compiled shader objects shared between programs.
+// Stages are keyed by (stage type, FNV-1a hash of the source); defines injected by
+// ShaderVariantCache are part of the source and therefore of the key. Programs
+// hold a reference while a stage is attached; unreferenced stages stay compiled
+// until trim() so later programs can still reuse them.
+// Thread safe; ShaderReloader acquires stages from its worker thread.
+class ShaderStageCache {
+public:
+	ShaderStageCache() = default;
+	~ShaderStageCache();
+	ShaderStageCache(const ShaderStageCache&) = delete;
+	ShaderStageCache& operator=(const ShaderStageCache&) = delete;
+
+	// Returns a shader object compiled (or compiling) from source and takes a reference.
+	// hit tells whether it was cached already.
+	GLuint acquire(GLenum shaderType, const ShaderSource& source, bool* hit = nullptr);
+	void release(GLuint shader);
+	// Deletes every stage no program currently references.
+	void trim();
+
+	size_t size() const;
+	ShaderStageCacheStats stats() const;
+	void printStats() const;
+
+private:
+	struct Entry {
+		GLuint shader = 0;
+		uint32_t references = 0;
+	};
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<uint64_t, Entry> m_entries;
+	std::unordered_map<GLuint, uint64_t> m_keys;	// shader object -> key
+	ShaderStageCacheStats m_stats;
+};
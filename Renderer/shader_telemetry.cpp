@@ -0,0 +1,118 @@
+#include "shader_telemetry.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+const char* binaryCacheName(BinaryCacheResult result)
+{
+	switch (result) {
+	case BinaryCacheResult::Hit: return "hit";
+	case BinaryCacheResult::Miss: return "miss";
+	default: return "off";
+	}
+}
+
+std::string jsonString(const std::string& str)
+{
+	std::string result = "\"";
+	for (auto c : str) {
+		switch (c) {
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				result += escaped;
+			} else {
+				result += c;
+			}
+		}
+	}
+	return result + "\"";
+}
+
+}
+
+ShaderTelemetry::ShaderTelemetry(const std::string& dumpPath)
+	:m_dumpPath(dumpPath)
+{
+}
+
+ShaderTelemetry::~ShaderTelemetry()
+{
+	if (!m_dumpPath.empty() && writeJson(m_dumpPath)) {
+		printf("shader telemetry written to %s\n", m_dumpPath.c_str());
+	}
+}
+
+ShaderTelemetryRecord* ShaderTelemetry::addRecord()
+{
+	m_records.emplace_back();
+	return &m_records.back();
+}
+
+const ShaderTelemetryRecord* ShaderTelemetry::find(GLuint program) const
+{
+	for (auto it = m_records.rbegin(); it != m_records.rend(); ++it) {
+		if (it->program == program) {
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+std::string ShaderTelemetry::toJson() const
+{
+	std::ostringstream ss;
+	ss << "{\n  \"programs\": [";
+	for (size_t i = 0; i < m_records.size(); ++i) {
+		const auto& record = m_records[i];
+		ss << (i ? ",\n" : "\n")
+			<< "    {\"name\": " << jsonString(record.name)
+			<< ", \"program\": " << record.program
+			<< ", \"linked\": " << (record.linked ? "true" : "false")
+			<< ", \"stages\": " << record.stages
+			<< ", \"sourceBytes\": " << record.sourceBytes
+			<< ", \"compileMs\": " << record.compileMs
+			<< ", \"linkMs\": " << record.linkMs
+			<< ", \"firstDrawMs\": " << record.firstDrawMs
+			<< ", \"binaryCache\": \"" << binaryCacheName(record.binaryCache) << "\""
+			<< ", \"stageCacheHits\": " << record.stageCacheHits
+			<< ", \"stageCacheMisses\": " << record.stageCacheMisses
+			<< ", \"activeUniforms\": " << record.activeUniforms
+			<< ", \"activeUniformBlocks\": " << record.activeUniformBlocks
+			<< ", \"activeAttributes\": " << record.activeAttributes
+			<< ", \"reloads\": " << record.reloads << "}";
+	}
+	ss << "\n  ]\n}\n";
+	return ss.str();
+}
+
+bool ShaderTelemetry::writeJson(const std::string& path) const
+{
+	std::ofstream fout(path, std::ios::trunc);
+	if (!fout) {
+		return false;
+	}
+	fout << toJson();
+	return static_cast<bool>(fout);
+}
+
+void ShaderTelemetry::printSummary() const
+{
+	double compile = 0.0;
+	double link = 0.0;
+	double firstDraw = 0.0;
+	for (const auto& record : m_records) {
+		compile += record.compileMs;
+		link += record.linkMs;
+		firstDraw += record.firstDrawMs > 0.0 ? record.firstDrawMs : 0.0;
+	}
+	printf("shader telemetry: %u programs, %.3f ms compile, %.3f ms link, %.3f ms first draw\n",
+		static_cast<unsigned>(m_records.size()), compile, link, firstDraw);
+}
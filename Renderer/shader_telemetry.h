@@ -0,0 +1,58 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+enum class BinaryCacheResult {
+	Off,
+	Hit,
+	Miss,
+};
+
+// Startup cost of one Shader. Times are wall clock in milliseconds on the calling
+// thread; drivers that compile lazily move part of the cost into firstDrawMs.
+struct ShaderTelemetryRecord {
+	std::string name;	// attached files, or "program <id>"
+	GLuint program = 0;
+	uint32_t stages = 0;
+	size_t sourceBytes = 0;
+	double compileMs = 0.0;	// stage submission, or the binary upload on a cache hit
+	double linkMs = 0.0;	// glLinkProgram until the link status is known
+	double firstDrawMs = -1.0;	// first draw timed by ShaderPrewarmer; -1 unless prewarmed
+	BinaryCacheResult binaryCache = BinaryCacheResult::Off;
+	uint32_t stageCacheHits = 0;
+	uint32_t stageCacheMisses = 0;
+	GLint activeUniforms = 0;
+	GLint activeUniformBlocks = 0;
+	GLint activeAttributes = 0;
+	bool linked = false;
+	uint32_t reloads = 0;
+};
+
+// Collects a record per Shader created while it is installed with
+// Shader::setTelemetry(). Must outlive those shaders. Records stay after their
+// Shader is destroyed, so the JSON written at exit covers the whole run.
+class ShaderTelemetry {
+public:
+	// A non-empty path is written by the destructor.
+	explicit ShaderTelemetry(const std::string& dumpPath = std::string());
+	~ShaderTelemetry();
+	ShaderTelemetry(const ShaderTelemetry&) = delete;
+	ShaderTelemetry& operator=(const ShaderTelemetry&) = delete;
+
+	// Pointers stay valid for the lifetime of the telemetry.
+	ShaderTelemetryRecord* addRecord();
+
+	const std::deque<ShaderTelemetryRecord>& records() const { return m_records; }
+	// Latest record of a program, nullptr if unknown.
+	const ShaderTelemetryRecord* find(GLuint program) const;
+
+	std::string toJson() const;
+	bool writeJson(const std::string& path) const;
+	void printSummary() const;
+
+private:
+	std::string m_dumpPath;
+	std::deque<ShaderTelemetryRecord> m_records;
+};
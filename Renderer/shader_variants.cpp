@@ -0,0 +1,141 @@
+#include "shader_variants.h"
+#include "hash.h"
+#include "shader.h"
+#include "shader_batch.h"
+#include <algorithm>
+
+void ShaderVariantCache::setSource(GLenum shaderType, const std::string& source)
+{
+	setSource(shaderType, ShaderSource::fromString(source));
+}
+
+void ShaderVariantCache::setSource(GLenum shaderType, ShaderSourcePtr source)
+{
+	m_sources[shaderType] = std::move(source);
+	// cached variants were built from the old source; callers may still hold them
+	for (auto& pair : m_variants) {
+		if (pair.second) {
+			m_stale.push_back(std::move(pair.second));
+		}
+	}
+	m_variants.clear();
+}
+
+void ShaderVariantCache::clear()
+{
+	m_variants.clear();
+	m_stale.clear();
+}
+
+bool ShaderVariantCache::setSourceFile(GLenum shaderType, const std::string& shaderFilePath, std::string* log)
+{
+	auto source = ShaderSourceCache::shared().load(shaderFilePath, log);
+	if (!source) {
+		return false;
+	}
+	setSource(shaderType, std::move(source));
+	return true;
+}
+
+uint64_t ShaderVariantCache::variantKey(const ShaderDefines& defines) const
+{
+	uint64_t key = FNV1A_OFFSET_BASIS;
+	for (const auto& pair : m_sources) {
+		auto sourceHash = pair.second->hash();
+		key = fnv1a(reinterpret_cast<const char*>(&pair.first), sizeof(pair.first), key);
+		key = fnv1a(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash), key);
+	}
+	for (const auto& define : normalizeDefines(defines)) {
+		// include the terminator so { "AB" } and { "A", "B" } differ
+		key = fnv1a(define.c_str(), define.size() + 1, key);
+	}
+	return key;
+}
+
+ShaderDefines ShaderVariantCache::normalizeDefines(const ShaderDefines& defines)
+{
+	ShaderDefines result;
+	for (auto define : defines) {
+		std::replace(define.begin(), define.end(), '=', ' ');
+		result.insert(std::move(define));
+	}
+	return result;
+}
+
+std::string ShaderVariantCache::injectDefines(const std::string& source, const ShaderDefines& defines)
+{
+	if (defines.empty()) {
+		return source;
+	}
+	return injectDefines(ShaderSource::fromString(source), defines)->str();
+}
+
+ShaderSourcePtr ShaderVariantCache::injectDefines(const ShaderSourcePtr& source, const ShaderDefines& defines)
+{
+	if (defines.empty()) {
+		return source;
+	}
+	std::string text;
+	for (const auto& define : normalizeDefines(defines)) {
+		text += "#define " + define + "\n";
+	}
+	return ShaderSource::insertAfterVersion(*source, text);
+}
+
+std::unique_ptr<Shader> ShaderVariantCache::createVariant(const ShaderDefines& defines, std::string* log)
+{
+	auto shader = std::make_unique<Shader>();
+	for (const auto& pair : m_sources) {
+		if (!shader->attachShaderSource(pair.first, injectDefines(pair.second, defines), log)) {
+			return nullptr;
+		}
+	}
+	return shader;
+}
+
+Shader* ShaderVariantCache::get(const ShaderDefines& defines, std::string* log)
+{
+	auto key = variantKey(defines);
+	auto it = m_variants.find(key);
+	if (it != m_variants.end()) {
+		return it->second.get();
+	}
+	auto shader = createVariant(defines, log);
+	if (shader && !shader->compile(log)) {
+		shader.reset();
+	}
+	auto result = shader.get();
+	m_variants[key] = std::move(shader);
+	return result;
+}
+
+bool ShaderVariantCache::prewarm(const std::vector<ShaderDefines>& variants, std::string* log)
+{
+	ShaderBatch batch;
+	std::vector<std::pair<uint64_t, std::unique_ptr<Shader>>> pending;
+	for (const auto& defines : variants) {
+		auto key = variantKey(defines);
+		if (m_variants.count(key) || std::any_of(pending.begin(), pending.end(),
+			[key](const auto& entry) { return entry.first == key; })) {
+			continue;
+		}
+		auto shader = std::make_unique<Shader>();
+		batch.add(*shader);
+		for (const auto& pair : m_sources) {
+			shader->attachShaderSource(pair.first, injectDefines(pair.second, defines));
+		}
+		pending.emplace_back(key, std::move(shader));
+	}
+	batch.submit();
+	bool success = batch.wait();
+	for (size_t i = 0; i < pending.size(); ++i) {
+		if (!batch.succeeded(i)) {
+			if (log) {
+				log->append(batch.log(i));
+			}
+			pending[i].second.reset();
+		}
+		m_variants[pending[i].first] = std::move(pending[i].second);
+	}
+	return success;
+}
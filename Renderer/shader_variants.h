@@ -0,0 +1,54 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader_source.h"
+
+class Shader;
+
+// Defines selecting a variant, e.g. { "USE_TEXTURE", "NUM_LIGHTS 4" }. A "NAME=VALUE"
+// entry is accepted as well and means the same as "NAME VALUE"; defines are
+// normalized to the latter before they are hashed or injected.
+using ShaderDefines = std::set<std::string>;
+
+// Permutations of one program built from a base source per stage plus a set of
+// defines injected after the #version line. Variants are linked on first request,
+// or up front with prewarm(), and cached under a 64-bit hash of sources and defines.
+// The Shaders handed out stay valid until clear() or destruction: a variant built
+// before setSource() keeps its old program, and later requests build a new one.
+class ShaderVariantCache {
+public:
+	void setSource(GLenum shaderType, const std::string& source);
+	void setSource(GLenum shaderType, ShaderSourcePtr source);
+	bool setSourceFile(GLenum shaderType, const std::string& shaderFilePath, std::string* log = nullptr);
+
+	// Returns the linked variant, or nullptr if it failed to build. A failed variant
+	// is remembered and not rebuilt on every request.
+	Shader* get(const ShaderDefines& defines, std::string* log = nullptr);
+	// Builds every listed variant that is not cached yet as one ShaderBatch.
+	bool prewarm(const std::vector<ShaderDefines>& variants, std::string* log = nullptr);
+
+	uint64_t variantKey(const ShaderDefines& defines) const;
+	size_t size() const { return m_variants.size(); }
+	// Destroys every variant, including those replaced by setSource().
+	void clear();
+
+	static ShaderDefines normalizeDefines(const ShaderDefines& defines);
+	static std::string injectDefines(const std::string& source, const ShaderDefines& defines);
+	// Shares the unchanged parts of source instead of copying them.
+	static ShaderSourcePtr injectDefines(const ShaderSourcePtr& source, const ShaderDefines& defines);
+
+private:
+	std::unique_ptr<Shader> createVariant(const ShaderDefines& defines, std::string* log);
+
+private:
+	std::map<GLenum, ShaderSourcePtr> m_sources;
+	std::unordered_map<uint64_t, std::unique_ptr<Shader>> m_variants;
+	// built from a previous source, kept alive for the pointers handed out
+	std::vector<std::unique_ptr<Shader>> m_stale;
+};
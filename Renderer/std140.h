@@ -0,0 +1,96 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time description of the GLSL std140 layout rules for the C++ types that
+// may appear in a uniform block struct. std140::layout<T>::valid is false for types
+// whose C++ representation differs from std140 (bool, glm::mat3, arrays of scalars
+// or vec2/vec3); use the padded wrappers below for those.
+namespace std140 {
+
+template<typename T>
+struct layout {
+	static constexpr bool valid = false;
+	static constexpr size_t alignment = 1;
+};
+
+template<> struct layout<float> { static constexpr bool valid = true; static constexpr size_t alignment = 4; };
+template<> struct layout<int32_t> { static constexpr bool valid = true; static constexpr size_t alignment = 4; };
+template<> struct layout<uint32_t> { static constexpr bool valid = true; static constexpr size_t alignment = 4; };
+
+template<typename T, glm::qualifier Q>
+struct layout<glm::vec<2, T, Q>> {
+	static constexpr bool valid = layout<T>::valid;
+	static constexpr size_t alignment = 8;
+};
+
+template<glm::length_t L, typename T, glm::qualifier Q>
+struct layout<glm::vec<L, T, Q>> {
+	static constexpr bool valid = layout<T>::valid && (L == 3 || L == 4);
+	static constexpr size_t alignment = 16;
+};
+
+// matrices are arrays of column vectors with a 16 byte stride, which glm only
+// matches when every column has four rows
+template<glm::length_t C, glm::length_t R, glm::qualifier Q>
+struct layout<glm::mat<C, R, float, Q>> {
+	static constexpr bool valid = (R == 4);
+	static constexpr size_t alignment = 16;
+};
+
+// arrays have a 16 byte element stride
+template<typename T, size_t N>
+struct layout<T[N]> {
+	static constexpr bool valid = layout<T>::valid && sizeof(T) % 16 == 0;
+	static constexpr size_t alignment = 16;
+};
+
+// Matrix with its columns padded to vec4, e.g. std140::mat<3, 3> for a GLSL mat3.
+template<glm::length_t C, glm::length_t R>
+struct mat {
+	glm::vec4 columns[C];
+
+	mat& operator=(const glm::mat<C, R, float>& m)
+	{
+		for (glm::length_t c = 0; c < C; ++c) {
+			for (glm::length_t r = 0; r < R; ++r) {
+				columns[c][r] = m[c][r];
+			}
+		}
+		return *this;
+	}
+};
+
+template<glm::length_t C, glm::length_t R>
+struct layout<mat<C, R>> {
+	static constexpr bool valid = true;
+	static constexpr size_t alignment = 16;
+};
+
+// Array element padded to the 16 byte std140 array stride.
+template<typename T>
+struct alignas(16) element {
+	T value;
+
+	element& operator=(const T& v)
+	{
+		value = v;
+		return *this;
+	}
+};
+
+template<typename T, size_t N>
+struct layout<element<T>[N]> {
+	static constexpr bool valid = layout<T>::valid;
+	static constexpr size_t alignment = 16;
+};
+
+}
+
+// Fails compilation if a member of a uniform block struct is of a type or at an
+// offset that does not follow std140.
+#define STD140_CHECK(Struct, member) \
+	static_assert(std140::layout<decltype(Struct::member)>::valid \
+		&& offsetof(Struct, member) % std140::layout<decltype(Struct::member)>::alignment == 0, \
+		#Struct "::" #member " does not follow the std140 layout")
@@ -0,0 +1,163 @@
+#include "stream_buffer.h"
+#include <chrono>
+#include <cstdio>
+#include "gl_state_cache.h"
+
+namespace {
+
+bool s_persistentMappingEnabled = true;
+
+// waits a second at a time, so a lost context cannot hang the caller forever
+const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+}
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize, uint32_t regions)
+	:m_target(target)
+	,m_regionSize(regionSize)
+	,m_regions(regions ? regions : 1)
+	,m_current(m_regions - 1)
+	,m_persistent(hasPersistentMapping())
+	,m_fences(m_regions, nullptr)
+{
+	auto& state = GLStateCache::current();
+	glGenBuffers(1, &m_buffer);
+	state.bindBuffer(m_target, m_buffer);
+	GLsizeiptr size = m_regionSize * m_regions;
+	if (m_persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(m_target, size, nullptr, flags);
+		m_mapped = static_cast<uint8_t*>(glMapBufferRange(m_target, 0, size, flags));
+		m_persistent = m_mapped != nullptr;
+	}
+	if (!m_persistent) {
+		// immutable storage cannot be orphaned; start over with a mutable buffer
+		glDeleteBuffers(1, &m_buffer);
+		state.onDeleteBuffer(m_buffer);
+		glGenBuffers(1, &m_buffer);
+		state.bindBuffer(m_target, m_buffer);
+		glBufferData(m_target, size, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (auto fence : m_fences) {
+		if (fence) {
+			glDeleteSync(fence);
+		}
+	}
+	if (m_buffer) {
+		auto& state = GLStateCache::current();
+		if (m_mapped) {
+			state.bindBuffer(m_target, m_buffer);
+			glUnmapBuffer(m_target);
+		}
+		glDeleteBuffers(1, &m_buffer);
+		state.onDeleteBuffer(m_buffer);
+	}
+}
+
+bool StreamBuffer::hasPersistentMapping()
+{
+	return s_persistentMappingEnabled && GLAD_GL_VERSION_4_4;
+}
+
+void StreamBuffer::setPersistentMappingEnabled(bool enabled)
+{
+	s_persistentMappingEnabled = enabled;
+}
+
+void StreamBuffer::beginFrame()
+{
+	if (m_inFrame) {
+		endFrame();
+	}
+	if (m_fencePending) {
+		// everything reading the previous region has been issued by now
+		m_fences[m_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_fencePending = false;
+	}
+	m_current = (m_current + 1) % m_regions;
+	m_used = 0;
+	m_inFrame = true;
+	++m_stats.frames;
+
+	if (m_persistent) {
+		auto& fence = m_fences[m_current];
+		if (!fence) {
+			return;
+		}
+		// usually signaled long ago; only time the waits that actually block
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			auto start = std::chrono::steady_clock::now();
+			GLenum result;
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+			} while (result == GL_TIMEOUT_EXPIRED);
+			++m_stats.fenceWaits;
+			m_stats.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+		return;
+	}
+
+	auto& state = GLStateCache::current();
+	state.bindBuffer(m_target, m_buffer);
+	if (m_current == 0) {
+		// every region of this storage has been written once; let the driver swap it
+		glBufferData(m_target, m_regionSize * m_regions, nullptr, GL_STREAM_DRAW);
+		++m_stats.orphans;
+	}
+	m_mapped = static_cast<uint8_t*>(glMapBufferRange(m_target, m_regionSize * m_current, m_regionSize,
+		GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	Allocation allocation;
+	GLsizeiptr start = alignment > 1 ? (m_used + alignment - 1) / alignment * alignment : m_used;
+	if (!m_inFrame || !m_mapped || start + size > m_regionSize) {
+		++m_stats.overflows;
+		return allocation;
+	}
+	m_used = start + size;
+	++m_stats.allocations;
+	GLintptr regionOffset = m_regionSize * m_current;
+	allocation.offset = regionOffset + start;
+	allocation.size = size;
+	allocation.data = m_mapped + (m_persistent ? allocation.offset : start);
+	return allocation;
+}
+
+void StreamBuffer::endFrame()
+{
+	if (!m_inFrame) {
+		return;
+	}
+	m_inFrame = false;
+	if (m_persistent) {
+		// coherent mapping: the writes need no flush, only a fence before reuse
+		m_fencePending = true;
+		return;
+	}
+	if (m_mapped) {
+		GLStateCache::current().bindBuffer(m_target, m_buffer);
+		glUnmapBuffer(m_target);
+		m_mapped = nullptr;
+	}
+}
+
+void StreamBuffer::printStats() const
+{
+	printf("stream buffer (%s, %u x %lld bytes): %llu frames, %llu allocations, %llu overflows, ",
+		m_persistent ? "persistent" : "orphaning", m_regions, static_cast<long long>(m_regionSize),
+		static_cast<unsigned long long>(m_stats.frames), static_cast<unsigned long long>(m_stats.allocations),
+		static_cast<unsigned long long>(m_stats.overflows));
+	if (m_persistent) {
+		printf("%llu fence waits (%.3f ms)\n", static_cast<unsigned long long>(m_stats.fenceWaits), m_stats.fenceWaitMs);
+	} else {
+		printf("%llu orphans\n", static_cast<unsigned long long>(m_stats.orphans));
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+struct StreamBufferStats {
+	uint64_t frames = 0;
+	uint64_t allocations = 0;
+	uint64_t overflows = 0;	// allocations that did not fit in their region
+	uint64_t fenceWaits = 0;	// regions the GPU was still reading when reused
+	double fenceWaitMs = 0.0;
+	uint64_t orphans = 0;	// storage replaced by the glBufferData fallback
+};
+
+// Ring buffer for data the CPU rewrites every frame: instance data, particles,
+// debug geometry. The buffer holds one region per frame in flight; a frame writes
+// only its own region, so nothing the GPU may still read is overwritten.
+// With GL 4.4 the storage is allocated with glBufferStorage and mapped once,
+// persistent and coherent; each region is guarded by a fence placed when the next
+// frame begins, and beginFrame() waits only if the GPU is still N frames behind.
+// Otherwise every region is mapped GL_MAP_UNSYNCHRONIZED_BIT for its frame, and
+// the whole buffer is orphaned with glBufferData(NULL) when the ring wraps,
+// letting the driver hand out fresh memory instead of synchronizing.
+class StreamBuffer {
+public:
+	struct Allocation {
+		void* data = nullptr;	// nullptr if the region is full
+		GLintptr offset = 0;	// from the start of buffer(), for attribute pointers and ranges
+		GLsizeiptr size = 0;
+	};
+
+	StreamBuffer(GLenum target, GLsizeiptr regionSize, uint32_t regions = 3);
+	~StreamBuffer();
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	static bool hasPersistentMapping();
+	static void setPersistentMappingEnabled(bool enabled);
+
+	// Fences the commands issued since the last frame began, then moves to the next
+	// region, waiting for the GPU to release it if necessary.
+	void beginFrame();
+	// Returns size bytes of the current region, or no data if the region is full.
+	Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+	// Ends the writes of this frame; the draws reading them are issued after it.
+	void endFrame();
+
+	GLuint buffer() const { return m_buffer; }
+	GLenum target() const { return m_target; }
+	bool isPersistent() const { return m_persistent; }
+	GLsizeiptr regionSize() const { return m_regionSize; }
+
+	const StreamBufferStats& stats() const { return m_stats; }
+	void printStats() const;
+
+private:
+	GLenum m_target;
+	GLuint m_buffer = 0;
+	GLsizeiptr m_regionSize;
+	uint32_t m_regions;
+	uint32_t m_current;
+	GLsizeiptr m_used = 0;
+	bool m_persistent = false;
+	bool m_inFrame = false;
+	bool m_fencePending = false;	// the current region was used and is not fenced yet
+	uint8_t* m_mapped = nullptr;	// whole buffer when persistent, current region otherwise
+	std::vector<GLsync> m_fences;
+	StreamBufferStats m_stats;
+};
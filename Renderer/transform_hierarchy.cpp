@@ -0,0 +1,234 @@
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <thread>
+
+void TransformHierarchy::reserve(size_t count)
+{
+	m_translation.reserve(count);
+	m_rotation.reserve(count);
+	m_scale.reserve(count);
+	m_world.reserve(count);
+	m_parent.reserve(count);
+	m_subtreeEnd.reserve(count);
+	m_ids.reserve(count);
+	m_dirty.reserve(count);
+	m_slots.reserve(count);
+}
+
+TransformHierarchy::NodeId TransformHierarchy::add(NodeId parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	auto id = static_cast<NodeId>(m_ids.size());
+	auto slot = static_cast<uint32_t>(m_ids.size());
+	uint32_t parentSlot = parent == NO_PARENT ? NO_PARENT : m_slots[parent];
+	m_translation.push_back(translation);
+	m_rotation.push_back(rotation);
+	m_scale.push_back(scale);
+	m_world.emplace_back(1.0f);
+	m_parent.push_back(parentSlot);
+	m_subtreeEnd.push_back(slot + 1);
+	m_ids.push_back(id);
+	m_slots.push_back(slot);
+	m_dirty.push_back(0);
+	// appended after the parent's existing subtree: still depth-first only for the last subtree
+	if (parentSlot != NO_PARENT && m_subtreeEnd[parentSlot] != slot) {
+		m_sorted = false;
+	}
+	for (auto ancestor = parentSlot; ancestor != NO_PARENT && m_sorted; ancestor = m_parent[ancestor]) {
+		m_subtreeEnd[ancestor] = slot + 1;
+	}
+	markDirty(id);
+	return id;
+}
+
+void TransformHierarchy::setTranslation(NodeId node, const glm::vec3& translation)
+{
+	m_translation[m_slots[node]] = translation;
+	markDirty(node);
+}
+
+void TransformHierarchy::setRotation(NodeId node, const glm::quat& rotation)
+{
+	m_rotation[m_slots[node]] = rotation;
+	markDirty(node);
+}
+
+void TransformHierarchy::setScale(NodeId node, const glm::vec3& scale)
+{
+	m_scale[m_slots[node]] = scale;
+	markDirty(node);
+}
+
+TransformHierarchy::NodeId TransformHierarchy::parent(NodeId node) const
+{
+	auto parentSlot = m_parent[m_slots[node]];
+	return parentSlot == NO_PARENT ? NO_PARENT : m_ids[parentSlot];
+}
+
+void TransformHierarchy::markDirty(NodeId node)
+{
+	if (!m_dirty[node]) {
+		m_dirty[node] = 1;
+		m_dirtyNodes.push_back(node);
+	}
+}
+
+void TransformHierarchy::sortDepthFirst()
+{
+	const size_t count = m_ids.size();
+	// children of every slot, in slot order, as ranges of one array
+	std::vector<uint32_t> childBegin(count + 1, 0);
+	for (auto parentSlot : m_parent) {
+		if (parentSlot != NO_PARENT) {
+			++childBegin[parentSlot + 1];
+		}
+	}
+	for (size_t i = 0; i < count; ++i) {
+		childBegin[i + 1] += childBegin[i];
+	}
+	std::vector<uint32_t> children(childBegin[count]);
+	{
+		std::vector<uint32_t> fill(childBegin.begin(), childBegin.end() - 1);
+		for (uint32_t slot = 0; slot < count; ++slot) {
+			if (m_parent[slot] != NO_PARENT) {
+				children[fill[m_parent[slot]]++] = slot;
+			}
+		}
+	}
+
+	// preorder walk; the stack holds slots, pushed in reverse to keep sibling order
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	std::vector<uint32_t> stack;
+	for (uint32_t root = 0; root < count; ++root) {
+		if (m_parent[root] != NO_PARENT) {
+			continue;
+		}
+		stack.push_back(root);
+		while (!stack.empty()) {
+			auto slot = stack.back();
+			stack.pop_back();
+			order.push_back(slot);
+			for (auto child = childBegin[slot + 1]; child > childBegin[slot]; --child) {
+				stack.push_back(children[child - 1]);
+			}
+		}
+	}
+
+	std::vector<uint32_t> newSlot(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		newSlot[order[i]] = i;
+	}
+	auto permute = [&order](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted;
+		sorted.reserve(values.size());
+		for (auto slot : order) {
+			sorted.push_back(values[slot]);
+		}
+		values.swap(sorted);
+	};
+	permute(m_translation);
+	permute(m_rotation);
+	permute(m_scale);
+	permute(m_world);
+	permute(m_ids);
+	permute(m_parent);
+	for (auto& parentSlot : m_parent) {
+		if (parentSlot != NO_PARENT) {
+			parentSlot = newSlot[parentSlot];
+		}
+	}
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		m_slots[m_ids[slot]] = slot;
+	}
+	// children follow their parent, so subtree ends accumulate backwards
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		m_subtreeEnd[slot] = slot + 1;
+	}
+	for (auto slot = static_cast<uint32_t>(count); slot-- > 0;) {
+		if (m_parent[slot] != NO_PARENT) {
+			m_subtreeEnd[m_parent[slot]] = std::max(m_subtreeEnd[m_parent[slot]], m_subtreeEnd[slot]);
+		}
+	}
+	m_sorted = true;
+}
+
+void TransformHierarchy::updateRange(size_t begin, size_t end)
+{
+	for (size_t slot = begin; slot < end; ++slot) {
+		glm::mat4 local = glm::mat4_cast(m_rotation[slot]);
+		local[0] = local[0] * m_scale[slot].x;
+		local[1] = local[1] * m_scale[slot].y;
+		local[2] = local[2] * m_scale[slot].z;
+		local[3] = glm::vec4(m_translation[slot], 1.0f);
+		auto parentSlot = m_parent[slot];
+		m_world[slot] = parentSlot == NO_PARENT ? local : m_world[parentSlot] * local;
+	}
+}
+
+size_t TransformHierarchy::update(unsigned threads)
+{
+	if (m_dirtyNodes.empty()) {
+		return 0;
+	}
+	if (!m_sorted) {
+		sortDepthFirst();
+	}
+
+	// the outermost changed nodes; each covers its subtree, and the subtrees are disjoint
+	std::vector<std::pair<uint32_t, uint32_t>> ranges;
+	std::vector<uint32_t> dirtySlots;
+	dirtySlots.reserve(m_dirtyNodes.size());
+	for (auto node : m_dirtyNodes) {
+		dirtySlots.push_back(m_slots[node]);
+		m_dirty[node] = 0;
+	}
+	m_dirtyNodes.clear();
+	std::sort(dirtySlots.begin(), dirtySlots.end());
+	size_t total = 0;
+	uint32_t covered = 0;
+	for (auto slot : dirtySlots) {
+		if (slot < covered) {
+			continue;
+		}
+		covered = m_subtreeEnd[slot];
+		ranges.emplace_back(slot, covered);
+		total += covered - slot;
+	}
+
+	if (!threads) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	if (threads < 2 || ranges.size() < 2 || total < PARALLEL_THRESHOLD) {
+		for (const auto& range : ranges) {
+			updateRange(range.first, range.second);
+		}
+		return total;
+	}
+
+	// hand each thread consecutive ranges holding about the same number of nodes
+	threads = static_cast<unsigned>(std::min<size_t>(threads, ranges.size()));
+	std::vector<size_t> firstRange(threads + 1, ranges.size());
+	firstRange[0] = 0;
+	size_t accumulated = 0;
+	unsigned next = 1;
+	for (size_t i = 0; i < ranges.size() && next < threads; ++i) {
+		accumulated += ranges[i].second - ranges[i].first;
+		if (accumulated * threads >= total * next) {
+			firstRange[next++] = i + 1;
+		}
+	}
+	auto work = [this, &ranges, &firstRange](unsigned t) {
+		for (size_t i = firstRange[t]; i < firstRange[t + 1]; ++i) {
+			updateRange(ranges[i].first, ranges[i].second);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threads; ++t) {
+		workers.emplace_back(work, t);
+	}
+	work(0);
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	return total;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Local translation/rotation/scale and world matrices of a node hierarchy, each in
+// its own contiguous array. Nodes are kept in depth-first order, so every parent
+// precedes its children and every subtree is one contiguous range; update()
+// recomputes a changed subtree with one linear pass over its range, reading the
+// parent's world matrix from an earlier slot instead of chasing pointers.
+// Setters queue their node; update() sorts the queue, drops nodes inside a subtree
+// already queued and recomputes the remaining ranges, so its cost follows the
+// number of nodes below changed nodes, not the size of the hierarchy. The ranges
+// are independent and are split across threads when enough of them changed.
+// Node ids stay valid while nodes are added; the depth-first order is restored on
+// the next update().
+class TransformHierarchy {
+public:
+	using NodeId = uint32_t;
+	static const NodeId NO_PARENT = UINT32_MAX;
+	// nodes to recompute before update() spreads the work across threads
+	static const size_t PARALLEL_THRESHOLD = 16384;
+
+	void reserve(size_t count);
+	// parent must have been added before.
+	NodeId add(NodeId parent = NO_PARENT, const glm::vec3& translation = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	void setTranslation(NodeId node, const glm::vec3& translation);
+	void setRotation(NodeId node, const glm::quat& rotation);
+	void setScale(NodeId node, const glm::vec3& scale);
+	const glm::vec3& translation(NodeId node) const { return m_translation[m_slots[node]]; }
+	const glm::quat& rotation(NodeId node) const { return m_rotation[m_slots[node]]; }
+	const glm::vec3& scale(NodeId node) const { return m_scale[m_slots[node]]; }
+	NodeId parent(NodeId node) const;
+
+	// Valid after update().
+	const glm::mat4& world(NodeId node) const { return m_world[m_slots[node]]; }
+
+	// Recomputes the world matrices of changed nodes and their descendants and
+	// returns how many were recomputed. threads 0 uses every hardware thread.
+	size_t update(unsigned threads = 1);
+
+	size_t size() const { return m_ids.size(); }
+
+private:
+	void markDirty(NodeId node);
+	void sortDepthFirst();
+	void updateRange(size_t begin, size_t end);
+
+private:
+	// indexed by slot, in depth-first order once sorted
+	std::vector<glm::vec3> m_translation;
+	std::vector<glm::quat> m_rotation;
+	std::vector<glm::vec3> m_scale;
+	std::vector<glm::mat4> m_world;
+	std::vector<uint32_t> m_parent;	// slot of the parent, NO_PARENT for roots
+	std::vector<uint32_t> m_subtreeEnd;	// one past the last descendant's slot
+	std::vector<NodeId> m_ids;
+	// indexed by node id
+	std::vector<uint32_t> m_slots;
+	std::vector<uint8_t> m_dirty;
+	std::vector<NodeId> m_dirtyNodes;
+	bool m_sorted = true;
+};
@@ -0,0 +1,332 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "hash.h"
+
+// Name of a uniform. Built from a string literal the FNV-1a hash is computed at
+// compile time, so setUniform("view", view) costs a table probe and nothing else.
+class UniformName {
+public:
+	template<size_t N>
+	constexpr UniformName(const char (&name)[N])
+		:m_hash(fnv1a(name, N - 1))
+	{
+	}
+	UniformName(const std::string& name)
+		:m_hash(fnv1a(name))
+	{
+	}
+	constexpr uint64_t hash() const { return m_hash; }
+
+private:
+	uint64_t m_hash;
+};
+
+namespace uniform_detail {
+
+template<typename T> struct dependent_false : std::false_type {};
+
+template<typename T> struct is_vec : std::false_type {};
+template<glm::length_t L, typename T, glm::qualifier Q>
+struct is_vec<glm::vec<L, T, Q>> : std::true_type {
+	static constexpr glm::length_t length = L;
+	using component = T;
+};
+
+template<typename T> struct is_mat : std::false_type {};
+template<glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+struct is_mat<glm::mat<C, R, T, Q>> : std::true_type {
+	static constexpr glm::length_t columns = C;
+	static constexpr glm::length_t rows = R;
+	using component = T;
+};
+
+template<typename T>
+constexpr GLenum scalarType()
+{
+	if constexpr (std::is_same_v<T, GLfloat>) {
+		return GL_FLOAT;
+	} else if constexpr (std::is_same_v<T, GLint>) {
+		return GL_INT;
+	} else if constexpr (std::is_same_v<T, GLuint>) {
+		return GL_UNSIGNED_INT;
+	} else if constexpr (std::is_same_v<T, bool>) {
+		return GL_BOOL;
+	} else {
+		return GL_NONE;
+	}
+}
+
+}
+
+// The GLSL type a C++ uniform value maps to, GL_NONE if it cannot be uploaded.
+template<typename T>
+constexpr GLenum uniformGLType()
+{
+	using namespace uniform_detail;
+	if constexpr (is_vec<T>::value) {
+		constexpr GLenum component = scalarType<typename is_vec<T>::component>();
+		constexpr glm::length_t length = is_vec<T>::length;
+		constexpr GLenum floatTypes[] = { GL_FLOAT, GL_FLOAT_VEC2, GL_FLOAT_VEC3, GL_FLOAT_VEC4 };
+		constexpr GLenum intTypes[] = { GL_INT, GL_INT_VEC2, GL_INT_VEC3, GL_INT_VEC4 };
+		constexpr GLenum uintTypes[] = { GL_UNSIGNED_INT, GL_UNSIGNED_INT_VEC2, GL_UNSIGNED_INT_VEC3, GL_UNSIGNED_INT_VEC4 };
+		constexpr GLenum boolTypes[] = { GL_BOOL, GL_BOOL_VEC2, GL_BOOL_VEC3, GL_BOOL_VEC4 };
+		if constexpr (component == GL_FLOAT) {
+			return floatTypes[length - 1];
+		} else if constexpr (component == GL_INT) {
+			return intTypes[length - 1];
+		} else if constexpr (component == GL_UNSIGNED_INT) {
+			return uintTypes[length - 1];
+		} else if constexpr (component == GL_BOOL) {
+			return boolTypes[length - 1];
+		} else {
+			return GL_NONE;
+		}
+	} else if constexpr (is_mat<T>::value) {
+		if constexpr (!std::is_same_v<typename is_mat<T>::component, GLfloat>) {
+			return GL_NONE;
+		} else {
+			constexpr GLenum matTypes[3][3] = {
+				{ GL_FLOAT_MAT2, GL_FLOAT_MAT2x3, GL_FLOAT_MAT2x4 },
+				{ GL_FLOAT_MAT3x2, GL_FLOAT_MAT3, GL_FLOAT_MAT3x4 },
+				{ GL_FLOAT_MAT4x2, GL_FLOAT_MAT4x3, GL_FLOAT_MAT4 },
+			};
+			return matTypes[is_mat<T>::columns - 2][is_mat<T>::rows - 2];
+		}
+	} else {
+		return scalarType<T>();
+	}
+}
+
+// Whether a value of type T may be written to a uniform reflected as glType.
+// Samplers and images are set through their texture unit as an int, and GLSL
+// bools accept int/uint/float data of the same width.
+template<typename T>
+bool isUniformTypeCompatible(GLenum glType)
+{
+	constexpr GLenum type = uniformGLType<T>();
+	if (type == glType) {
+		return true;
+	}
+	switch (glType) {
+	case GL_BOOL:
+		return type == GL_INT || type == GL_UNSIGNED_INT || type == GL_FLOAT;
+	case GL_BOOL_VEC2:
+		return type == GL_INT_VEC2 || type == GL_UNSIGNED_INT_VEC2 || type == GL_FLOAT_VEC2;
+	case GL_BOOL_VEC3:
+		return type == GL_INT_VEC3 || type == GL_UNSIGNED_INT_VEC3 || type == GL_FLOAT_VEC3;
+	case GL_BOOL_VEC4:
+		return type == GL_INT_VEC4 || type == GL_UNSIGNED_INT_VEC4 || type == GL_FLOAT_VEC4;
+	case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+	case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+	case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+	case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+	case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+	case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+		return false;
+	default:
+		// sampler and image types
+		return type == GL_INT;
+	}
+}
+
+// Uploads count elements with glProgramUniform* when program is non-zero (GL 4.1),
+// otherwise with glUniform* to the bound program. The entry point is selected at
+// compile time from T. Bools are converted to GLint by UniformStorage first, so an
+// array goes up in one *iv call.
+#define UNIFORM_CALL(suffix, ...) \
+	(program ? glProgramUniform##suffix(program, __VA_ARGS__) : glUniform##suffix(__VA_ARGS__))
+
+template<typename T>
+void uploadUniform(GLuint program, GLint location, const T* values, GLsizei count)
+{
+	using namespace uniform_detail;
+	static_assert(uniformGLType<T>() != GL_NONE, "type cannot be uploaded as a uniform");
+	if constexpr (std::is_same_v<T, GLfloat>) {
+		UNIFORM_CALL(1fv, location, count, values);
+	} else if constexpr (std::is_same_v<T, GLint>) {
+		UNIFORM_CALL(1iv, location, count, values);
+	} else if constexpr (std::is_same_v<T, GLuint>) {
+		UNIFORM_CALL(1uiv, location, count, values);
+	} else if constexpr (is_vec<T>::value) {
+		constexpr glm::length_t length = is_vec<T>::length;
+		using Component = typename is_vec<T>::component;
+		auto data = glm::value_ptr(values[0]);
+		if constexpr (std::is_same_v<Component, GLfloat>) {
+			if constexpr (length == 2) UNIFORM_CALL(2fv, location, count, data);
+			else if constexpr (length == 3) UNIFORM_CALL(3fv, location, count, data);
+			else UNIFORM_CALL(4fv, location, count, data);
+		} else if constexpr (std::is_same_v<Component, GLint>) {
+			if constexpr (length == 2) UNIFORM_CALL(2iv, location, count, data);
+			else if constexpr (length == 3) UNIFORM_CALL(3iv, location, count, data);
+			else UNIFORM_CALL(4iv, location, count, data);
+		} else if constexpr (std::is_same_v<Component, GLuint>) {
+			if constexpr (length == 2) UNIFORM_CALL(2uiv, location, count, data);
+			else if constexpr (length == 3) UNIFORM_CALL(3uiv, location, count, data);
+			else UNIFORM_CALL(4uiv, location, count, data);
+		} else {
+			static_assert(dependent_false<T>::value, "convert bools through UniformStorage");
+		}
+	} else if constexpr (is_mat<T>::value) {
+		constexpr glm::length_t columns = is_mat<T>::columns;
+		constexpr glm::length_t rows = is_mat<T>::rows;
+		auto data = glm::value_ptr(values[0]);
+		if constexpr (columns == 2 && rows == 2) UNIFORM_CALL(Matrix2fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 3 && rows == 3) UNIFORM_CALL(Matrix3fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 4 && rows == 4) UNIFORM_CALL(Matrix4fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 2 && rows == 3) UNIFORM_CALL(Matrix2x3fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 2 && rows == 4) UNIFORM_CALL(Matrix2x4fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 3 && rows == 2) UNIFORM_CALL(Matrix3x2fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 3 && rows == 4) UNIFORM_CALL(Matrix3x4fv, location, count, GL_FALSE, data);
+		else if constexpr (columns == 4 && rows == 2) UNIFORM_CALL(Matrix4x2fv, location, count, GL_FALSE, data);
+		else UNIFORM_CALL(Matrix4x3fv, location, count, GL_FALSE, data);
+	} else {
+		// bool included: convert it through UniformStorage
+		static_assert(dependent_false<T>::value, "unsupported uniform type");
+	}
+}
+
+#undef UNIFORM_CALL
+
+// Representation of T in the shadow storage of UniformState: GLSL bools are
+// stored and uploaded as GLint, everything else as is.
+template<typename T>
+struct UniformStorage {
+	using Type = T;
+	static Type convert(const T& value) { return value; }
+};
+
+template<>
+struct UniformStorage<bool> {
+	using Type = GLint;
+	static Type convert(bool value) { return value ? 1 : 0; }
+};
+
+template<glm::length_t L, glm::qualifier Q>
+struct UniformStorage<glm::vec<L, bool, Q>> {
+	using Type = glm::vec<L, GLint, Q>;
+	static Type convert(const glm::vec<L, bool, Q>& value)
+	{
+		Type converted;
+		for (glm::length_t c = 0; c < L; ++c) {
+			converted[c] = value[c] ? 1 : 0;
+		}
+		return converted;
+	}
+};
+
+// Type-erased uploader stored with each dirty uniform; instantiated from the
+// storage type so the glUniform* entry point is still chosen at compile time.
+using UniformUploader = void (*)(GLuint program, GLint location, GLsizei count, const void* data);
+
+template<typename T>
+void uploadUniformData(GLuint program, GLint location, GLsizei count, const void* data)
+{
+	uploadUniform(program, location, static_cast<const T*>(data), count);
+}
+
+// Uploader for data already in shadow storage format, picked from the reflected
+// GLSL type; nullptr for types the shadow storage does not handle.
+inline UniformUploader uniformUploader(GLenum glType)
+{
+	switch (glType) {
+	case GL_FLOAT: return &uploadUniformData<GLfloat>;
+	case GL_FLOAT_VEC2: return &uploadUniformData<glm::vec2>;
+	case GL_FLOAT_VEC3: return &uploadUniformData<glm::vec3>;
+	case GL_FLOAT_VEC4: return &uploadUniformData<glm::vec4>;
+	case GL_INT: case GL_BOOL: return &uploadUniformData<GLint>;
+	case GL_INT_VEC2: case GL_BOOL_VEC2: return &uploadUniformData<glm::ivec2>;
+	case GL_INT_VEC3: case GL_BOOL_VEC3: return &uploadUniformData<glm::ivec3>;
+	case GL_INT_VEC4: case GL_BOOL_VEC4: return &uploadUniformData<glm::ivec4>;
+	case GL_UNSIGNED_INT: return &uploadUniformData<GLuint>;
+	case GL_UNSIGNED_INT_VEC2: return &uploadUniformData<glm::uvec2>;
+	case GL_UNSIGNED_INT_VEC3: return &uploadUniformData<glm::uvec3>;
+	case GL_UNSIGNED_INT_VEC4: return &uploadUniformData<glm::uvec4>;
+	case GL_FLOAT_MAT2: return &uploadUniformData<glm::mat2>;
+	case GL_FLOAT_MAT3: return &uploadUniformData<glm::mat3>;
+	case GL_FLOAT_MAT4: return &uploadUniformData<glm::mat4>;
+	case GL_FLOAT_MAT2x3: return &uploadUniformData<glm::mat2x3>;
+	case GL_FLOAT_MAT2x4: return &uploadUniformData<glm::mat2x4>;
+	case GL_FLOAT_MAT3x2: return &uploadUniformData<glm::mat3x2>;
+	case GL_FLOAT_MAT3x4: return &uploadUniformData<glm::mat3x4>;
+	case GL_FLOAT_MAT4x2: return &uploadUniformData<glm::mat4x2>;
+	case GL_FLOAT_MAT4x3: return &uploadUniformData<glm::mat4x3>;
+	case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+	case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+	case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2:
+	case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+		return nullptr;
+	default:
+		// sampler and image types
+		return &uploadUniformData<GLint>;
+	}
+}
+
+// Element type, pointer and count of a value passed to setUniform: a single value,
+// a C array, a std::array or a std::vector.
+template<typename T>
+struct UniformValue {
+	using Element = T;
+	static const T* data(const T& value) { return &value; }
+	static GLsizei count(const T&) { return 1; }
+};
+
+template<typename T, size_t N>
+struct UniformValue<T[N]> {
+	using Element = T;
+	static const T* data(const T (&value)[N]) { return value; }
+	static GLsizei count(const T (&)[N]) { return static_cast<GLsizei>(N); }
+};
+
+template<typename T, size_t N>
+struct UniformValue<std::array<T, N>> {
+	using Element = T;
+	static const T* data(const std::array<T, N>& value) { return value.data(); }
+	static GLsizei count(const std::array<T, N>&) { return static_cast<GLsizei>(N); }
+};
+
+template<typename T>
+struct UniformValue<std::vector<T>> {
+	static_assert(!std::is_same_v<T, bool>, "std::vector<bool> has no contiguous storage");
+	using Element = T;
+	static const T* data(const std::vector<T>& value) { return value.data(); }
+	static GLsizei count(const std::vector<T>& value) { return static_cast<GLsizei>(value.size()); }
+};
+
+class Shader;
+struct UniformInfo;
+
+// Typed handle to a uniform of one program, resolved once through Shader::uniform<T>().
+// Writes go to the shadow state of the program and are uploaded by Shader::flush().
+// A handle survives relinking: it re-resolves itself when the program changed.
+template<typename T>
+class Uniform {
+public:
+	Uniform() = default;
+
+	bool isValid() const { return m_shader != nullptr; }
+
+	bool set(const T& value) const
+	{
+		return set(&value, 1);
+	}
+	bool set(const T* values, GLsizei count) const;
+
+private:
+	friend class Shader;
+	Uniform(Shader* shader, uint64_t hash)
+		:m_shader(shader), m_hash(hash)
+	{
+	}
+
+	Shader* m_shader = nullptr;
+	uint64_t m_hash = 0;
+	mutable const UniformInfo* m_info = nullptr;
+	mutable uint32_t m_generation = 0;
+};
@@ -0,0 +1,81 @@
+#include "uniform_block.h"
+#include "gl_state_cache.h"
+#include <map>
+#include <vector>
+
+namespace {
+
+std::map<std::string, GLuint>& blockBindings()
+{
+	static std::map<std::string, GLuint> bindings;
+	return bindings;
+}
+
+}
+
+GLuint UniformBlockRegistry::binding(const std::string& blockName)
+{
+	auto& bindings = blockBindings();
+	auto it = bindings.find(blockName);
+	if (it != bindings.end()) {
+		return it->second;
+	}
+	auto binding = static_cast<GLuint>(bindings.size());
+	bindings[blockName] = binding;
+	return binding;
+}
+
+void UniformBlockRegistry::bindProgram(GLuint program)
+{
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	std::vector<char> name(maxLength > 0 ? maxLength : 1);
+	for (GLint i = 0; i < count; ++i) {
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()), &length, name.data());
+		glUniformBlockBinding(program, i, binding(std::string(name.data(), length)));
+	}
+}
+
+UniformBlockBuffer::UniformBlockBuffer(const std::string& blockName, size_t size, uint32_t frames)
+	:m_name(blockName), m_size(size), m_frames(frames ? frames : 1)
+{
+	m_binding = UniformBlockRegistry::binding(blockName);
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_stride = alignment > 0 ? (m_size + alignment - 1) / alignment * alignment : m_size;
+	if (GLAD_GL_VERSION_4_5) {
+		glCreateBuffers(1, &m_buffer);
+		glNamedBufferData(m_buffer, m_stride * m_frames, nullptr, GL_DYNAMIC_DRAW);
+	} else {
+		glGenBuffers(1, &m_buffer);
+		GLStateCache::current().bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, m_stride * m_frames, nullptr, GL_DYNAMIC_DRAW);
+	}
+	m_current = m_frames - 1;
+}
+
+UniformBlockBuffer::~UniformBlockBuffer()
+{
+	if (m_buffer) {
+		glDeleteBuffers(1, &m_buffer);
+		GLStateCache::current().onDeleteBuffer(m_buffer);
+		m_buffer = 0;
+	}
+}
+
+void UniformBlockBuffer::upload(const void* data)
+{
+	m_current = (m_current + 1) % m_frames;
+	auto offset = static_cast<GLintptr>(m_stride * m_current);
+	auto& state = GLStateCache::current();
+	if (GLAD_GL_VERSION_4_5) {
+		glNamedBufferSubData(m_buffer, offset, m_size, data);
+	} else {
+		state.bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, m_size, data);
+	}
+	state.bindBufferRange(GL_UNIFORM_BUFFER, m_binding, m_buffer, offset, m_size);
+}
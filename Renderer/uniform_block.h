@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include "std140.h"
+
+// Maps uniform block names to binding points. Blocks and programs both ask for
+// the binding of a name, so creation order does not matter.
+class UniformBlockRegistry {
+public:
+	static GLuint binding(const std::string& blockName);
+	// Assigns every active uniform block of a linked program its binding point.
+	static void bindProgram(GLuint program);
+};
+
+// Uniform buffer shared by every program declaring the named block. Holds one
+// region per frame in flight; each upload writes the next region and rebinds it
+// with glBindBufferRange, so a frame never overwrites data the GPU may still read.
+class UniformBlockBuffer {
+public:
+	UniformBlockBuffer(const std::string& blockName, size_t size, uint32_t frames);
+	~UniformBlockBuffer();
+	UniformBlockBuffer(const UniformBlockBuffer&) = delete;
+	UniformBlockBuffer& operator=(const UniformBlockBuffer&) = delete;
+
+	void upload(const void* data);
+
+	const std::string& name() const { return m_name; }
+	GLuint binding() const { return m_binding; }
+	GLuint buffer() const { return m_buffer; }
+
+private:
+	std::string m_name;
+	GLuint m_binding = 0;
+	GLuint m_buffer = 0;
+	size_t m_size = 0;
+	size_t m_stride = 0;
+	uint32_t m_frames = 0;
+	uint32_t m_current = 0;
+};
+
+// CPU copy of a std140 uniform block. T must be a standard-layout struct whose
+// members are checked with STD140_CHECK.
+template<typename T>
+class UniformBlock : public UniformBlockBuffer {
+	static_assert(std::is_standard_layout_v<T>, "uniform block structs must be standard layout");
+	static_assert(sizeof(T) % 16 == 0, "std140 blocks are padded to a multiple of 16 bytes");
+
+public:
+	explicit UniformBlock(const std::string& blockName, uint32_t frames = 3)
+		:UniformBlockBuffer(blockName, sizeof(T), frames)
+	{
+	}
+
+	T& data() { return m_data; }
+	const T& data() const { return m_data; }
+	void upload() { UniformBlockBuffer::upload(&m_data); }
+
+private:
+	T m_data {};
+};
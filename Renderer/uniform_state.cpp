@@ -0,0 +1,106 @@
+#include "uniform_state.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+bool isUnsignedType(GLenum type)
+{
+	return type == GL_UNSIGNED_INT || type == GL_UNSIGNED_INT_VEC2
+		|| type == GL_UNSIGNED_INT_VEC3 || type == GL_UNSIGNED_INT_VEC4;
+}
+
+bool isFloatType(GLenum type)
+{
+	switch (type) {
+	case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+	case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+	case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+	case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+		return true;
+	default:
+		return false;
+	}
+}
+
+}
+
+void UniformState::build(GLuint program, const UniformTable& table)
+{
+	clear();
+	m_table = &table;
+	m_values.assign(table.storageSize(), 0);
+	m_uploaders.assign(table.records().size(), nullptr);
+	// element locations are only known through the table, so read back per entry;
+	// aliases of the same element just read it again
+	for (const auto& info : table.uniforms()) {
+		const auto& record = table.records()[info.record];
+		if (!record.elementBytes) {
+			continue;
+		}
+		void* data = m_values.data() + info.offset;
+		if (isFloatType(record.type)) {
+			glGetUniformfv(program, info.location, static_cast<GLfloat*>(data));
+		} else if (isUnsignedType(record.type)) {
+			glGetUniformuiv(program, info.location, static_cast<GLuint*>(data));
+		} else {
+			glGetUniformiv(program, info.location, static_cast<GLint*>(data));
+		}
+	}
+}
+
+void UniformState::clear()
+{
+	m_table = nullptr;
+	m_values.clear();
+	m_uploaders.clear();
+	m_dirty.clear();
+}
+
+bool UniformState::write(const UniformInfo& info, const void* data, uint32_t bytes, UniformUploader uploader)
+{
+	const auto& record = m_table->records()[info.record];
+	if (!record.elementBytes || info.offset + bytes > record.offset + record.elementBytes * record.size) {
+		return false;
+	}
+	++m_stats.writes;
+	auto shadow = m_values.data() + info.offset;
+	if (0 == memcmp(shadow, data, bytes)) {
+		return true;
+	}
+	memcpy(shadow, data, bytes);
+	if (!m_uploaders[info.record]) {
+		m_dirty.push_back(info.record);
+	}
+	m_uploaders[info.record] = uploader;
+	return true;
+}
+
+void UniformState::restore(const UniformTable& previousTable, const UniformState& previous)
+{
+	for (const auto& info : m_table->uniforms()) {
+		const auto& record = m_table->records()[info.record];
+		// one entry per record: the one starting at the record's storage
+		if (info.offset != record.offset || info.location != record.location) {
+			continue;
+		}
+		auto old = previousTable.find(info.name);
+		if (!old || old->type != info.type || !record.elementBytes) {
+			continue;
+		}
+		auto count = std::min(info.size, old->size);
+		auto uploader = uniformUploader(info.type);
+		write(info, previous.m_values.data() + old->offset, record.elementBytes * count, uploader);
+	}
+}
+
+void UniformState::flush(GLuint program)
+{
+	for (auto index : m_dirty) {
+		const auto& record = m_table->records()[index];
+		m_uploaders[index](program, record.location, record.size, m_values.data() + record.offset);
+		m_uploaders[index] = nullptr;
+		++m_stats.issued;
+	}
+	m_dirty.clear();
+}
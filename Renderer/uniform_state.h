@@ -0,0 +1,44 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include "uniform.h"
+#include "uniform_table.h"
+
+struct UniformStats {
+	uint64_t writes = 0;	// setUniform calls that reached the shadow state
+	uint64_t issued = 0;	// glUniform* calls made by flush()
+
+	uint64_t skipped() const { return writes > issued ? writes - issued : 0; }
+};
+
+// CPU-side copy of every active uniform of a program. Writes are compared with the
+// shadow value and only mark the uniform dirty; flush() uploads each dirty uniform
+// (a whole array at once) with a single glUniform* call.
+class UniformState {
+public:
+	// Reads the current values back from the program so the shadow starts in sync,
+	// including uniforms with GLSL initializers.
+	void build(GLuint program, const UniformTable& table);
+	void clear();
+
+	// Returns true if data was accepted; bytes must not exceed the storage of info.
+	bool write(const UniformInfo& info, const void* data, uint32_t bytes, UniformUploader uploader);
+	// Copies the values of uniforms that exist with the same name and type in
+	// another state, e.g. the one of the program a reload replaced.
+	void restore(const UniformTable& previousTable, const UniformState& previous);
+	// Uploads the dirty uniforms with glProgramUniform* to program, or with
+	// glUniform* to the currently bound program when program is 0.
+	void flush(GLuint program = 0);
+	bool isDirty() const { return !m_dirty.empty(); }
+
+	const UniformStats& stats() const { return m_stats; }
+	void resetStats() { m_stats = UniformStats(); }
+
+private:
+	const UniformTable* m_table = nullptr;
+	std::vector<uint8_t> m_values;
+	std::vector<UniformUploader> m_uploaders;	// per record, set when it gets dirty
+	std::vector<uint32_t> m_dirty;	// records to upload on the next flush
+	UniformStats m_stats;
+};
@@ -0,0 +1,179 @@
+#include "uniform_table.h"
+#include "hash.h"
+
+uint32_t uniformElementBytes(GLenum type)
+{
+	switch (type) {
+	case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+		return 2 * 4;
+	case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+		return 3 * 4;
+	case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+	case GL_FLOAT_MAT2:
+		return 4 * 4;
+	case GL_FLOAT_MAT3:
+		return 9 * 4;
+	case GL_FLOAT_MAT4:
+		return 16 * 4;
+	case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+		return 6 * 4;
+	case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+		return 8 * 4;
+	case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+		return 12 * 4;
+	case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+	case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+	case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2:
+	case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+		return 0;
+	default:
+		// float, int, uint, bool and every sampler/image type
+		return 4;
+	}
+}
+
+void UniformTable::build(GLuint program)
+{
+	clear();
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	if (count <= 0) {
+		return;
+	}
+	std::string name(maxLength > 0 ? maxLength : 1, '\0');
+	for (GLint i = 0; i < count; ++i) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(program, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+		UniformInfo info;
+		info.name.assign(name.data(), length);
+		info.type = type;
+		info.size = size;
+		info.location = glGetUniformLocation(program, info.name.c_str());
+		// members of uniform blocks have no location
+		if (-1 == info.location) {
+			continue;
+		}
+		UniformRecord record;
+		record.location = info.location;
+		record.type = type;
+		record.size = size;
+		record.offset = m_storageSize;
+		record.elementBytes = uniformElementBytes(type);
+		m_storageSize += record.elementBytes * size;
+		info.record = static_cast<uint32_t>(m_records.size());
+		info.offset = record.offset;
+		m_records.push_back(record);
+		// arrays are reported as "name[0]": register the bare name as well as
+		// every element so "name[3]" resolves without a driver query
+		auto bracket = info.name.rfind("[0]");
+		if (bracket != std::string::npos && bracket + 3 == info.name.size()) {
+			std::string baseName = info.name.substr(0, bracket);
+			for (GLint element = 1; element < size; ++element) {
+				UniformInfo elementInfo = info;
+				elementInfo.name = baseName + "[" + std::to_string(element) + "]";
+				elementInfo.location = glGetUniformLocation(program, elementInfo.name.c_str());
+				elementInfo.size = size - element;
+				elementInfo.offset = info.offset + record.elementBytes * element;
+				insert(std::move(elementInfo));
+			}
+			UniformInfo baseInfo = info;
+			baseInfo.name = baseName;
+			insert(std::move(baseInfo));
+		}
+		insert(std::move(info));
+	}
+}
+
+void UniformTable::clear()
+{
+	m_uniforms.clear();
+	m_slots.clear();
+	m_locations.clear();
+	m_records.clear();
+	m_storageSize = 0;
+}
+
+void UniformTable::insert(UniformInfo info)
+{
+	info.hash = fnv1a(info.name);
+	if (info.location >= 0) {
+		if (m_locations.size() <= static_cast<size_t>(info.location)) {
+			m_locations.resize(info.location + 1, -1);
+		}
+		// the bare name of an array shares the location of its first element
+		if (-1 == m_locations[info.location]) {
+			m_locations[info.location] = static_cast<int32_t>(m_uniforms.size());
+		}
+	}
+	m_uniforms.push_back(std::move(info));
+	// keep the load factor at or below 1/2
+	if (m_slots.size() < m_uniforms.size() * 2) {
+		rehash();
+		return;
+	}
+	size_t mask = m_slots.size() - 1;
+	size_t slot = m_uniforms.back().hash & mask;
+	while (m_slots[slot] != -1) {
+		slot = (slot + 1) & mask;
+	}
+	m_slots[slot] = static_cast<int32_t>(m_uniforms.size() - 1);
+}
+
+void UniformTable::rehash()
+{
+	size_t capacity = 16;
+	while (capacity < m_uniforms.size() * 2) {
+		capacity <<= 1;
+	}
+	m_slots.assign(capacity, -1);
+	size_t mask = capacity - 1;
+	for (size_t i = 0; i < m_uniforms.size(); ++i) {
+		size_t slot = m_uniforms[i].hash & mask;
+		while (m_slots[slot] != -1) {
+			slot = (slot + 1) & mask;
+		}
+		m_slots[slot] = static_cast<int32_t>(i);
+	}
+}
+
+const UniformInfo* UniformTable::find(uint64_t hash) const
+{
+	if (m_slots.empty()) {
+		return nullptr;
+	}
+	size_t mask = m_slots.size() - 1;
+	for (size_t slot = hash & mask; m_slots[slot] != -1; slot = (slot + 1) & mask) {
+		const UniformInfo& info = m_uniforms[m_slots[slot]];
+		if (info.hash == hash) {
+			return &info;
+		}
+	}
+	return nullptr;
+}
+
+const UniformInfo* UniformTable::find(const std::string& name) const
+{
+	auto info = find(fnv1a(name));
+	if (info && info->name != name) {
+		return nullptr;
+	}
+	return info;
+}
+
+const UniformInfo* UniformTable::findByLocation(GLint location) const
+{
+	if (location < 0 || static_cast<size_t>(location) >= m_locations.size() || -1 == m_locations[location]) {
+		return nullptr;
+	}
+	return &m_uniforms[m_locations[location]];
+}
+
+GLint UniformTable::location(const std::string& name) const
+{
+	auto info = find(name);
+	return info ? info->location : -1;
+}
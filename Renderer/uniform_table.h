@@ -0,0 +1,59 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct UniformInfo {
+	std::string name;
+	uint64_t hash = 0;
+	GLint location = -1;
+	GLenum type = GL_NONE;
+	GLint size = 0;		// number of array elements, 1 for non-array uniforms
+	uint32_t record = 0;	// index of the UniformRecord backing this uniform
+	uint32_t offset = 0;	// byte offset of the first element in the shadow storage
+};
+
+// One active uniform as reported by the driver. Array elements registered by name
+// in the table share the record of their array.
+struct UniformRecord {
+	GLint location = -1;
+	GLenum type = GL_NONE;
+	GLint size = 0;
+	uint32_t offset = 0;
+	uint32_t elementBytes = 0;
+};
+
+// Size in bytes of one element of a uniform of the given GLSL type as passed to
+// glUniform*v, 0 for types the shadow storage does not handle (doubles).
+uint32_t uniformElementBytes(GLenum type);
+
+// Flat open-addressing table of the active uniforms of a linked program, keyed by
+// the FNV-1a hash of the uniform name. Built once after linking so that name based
+// lookups never go back to the driver.
+class UniformTable {
+public:
+	void build(GLuint program);
+	void clear();
+
+	const UniformInfo* find(uint64_t hash) const;
+	const UniformInfo* find(const std::string& name) const;
+	const UniformInfo* findByLocation(GLint location) const;
+	GLint location(const std::string& name) const;
+
+	size_t size() const { return m_uniforms.size(); }
+	const std::vector<UniformInfo>& uniforms() const { return m_uniforms; }
+	const std::vector<UniformRecord>& records() const { return m_records; }
+	uint32_t storageSize() const { return m_storageSize; }
+
+private:
+	void insert(UniformInfo info);
+	void rehash();
+
+private:
+	std::vector<UniformInfo> m_uniforms;
+	std::vector<int32_t> m_slots;	// indices into m_uniforms, -1 for an empty slot
+	std::vector<int32_t> m_locations;	// location -> index into m_uniforms
+	std::vector<UniformRecord> m_records;
+	uint32_t m_storageSize = 0;
+};
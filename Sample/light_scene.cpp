@@ -0,0 +1,350 @@
+#include "light_scene.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "gl_state_cache.h"
+#include "mesh.h"
+#include "shader_prewarm.h"
+#include "shader_source.h"
+#include "shader_variants.h"
+
+// set by CMake to the directory holding the shaders
+#ifndef SAMPLE_ASSET_DIR
+#define SAMPLE_ASSET_DIR "."
+#endif
+
+namespace {
+
+const float s_vertices[] = {
+	//     ---- 位置 ----
+	-0.5f, -0.5f, -0.5f,
+	 0.5f, -0.5f, -0.5f,
+	 0.5f,  0.5f, -0.5f,
+	 0.5f,  0.5f, -0.5f,
+	-0.5f,  0.5f, -0.5f,
+	-0.5f, -0.5f, -0.5f,
+
+	-0.5f, -0.5f,  0.5f,
+	 0.5f, -0.5f,  0.5f,
+	 0.5f,  0.5f,  0.5f,
+	 0.5f,  0.5f,  0.5f,
+	-0.5f,  0.5f,  0.5f,
+	-0.5f, -0.5f,  0.5f,
+
+	-0.5f,  0.5f,  0.5f,
+	-0.5f,  0.5f, -0.5f,
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, -0.5f,  0.5f,
+	-0.5f,  0.5f,  0.5f,
+
+	 0.5f,  0.5f,  0.5f,
+	 0.5f,  0.5f, -0.5f,
+	 0.5f, -0.5f, -0.5f,
+	 0.5f, -0.5f, -0.5f,
+	 0.5f, -0.5f,  0.5f,
+	 0.5f,  0.5f,  0.5f,
+
+	-0.5f, -0.5f, -0.5f,
+	 0.5f, -0.5f, -0.5f,
+	 0.5f, -0.5f,  0.5f,
+	 0.5f, -0.5f,  0.5f,
+	-0.5f, -0.5f,  0.5f,
+	-0.5f, -0.5f, -0.5f,
+
+	-0.5f,  0.5f, -0.5f,
+	 0.5f,  0.5f, -0.5f,
+	 0.5f,  0.5f,  0.5f,
+	 0.5f,  0.5f,  0.5f,
+	-0.5f,  0.5f,  0.5f,
+	-0.5f,  0.5f, -0.5f,
+};
+
+const GLsizei s_vertexCount = sizeof(s_vertices) / (3 * sizeof(float));
+
+}
+
+LightScene::LightScene(int instances, DrawMode mode)
+	:m_mode(mode)
+	,m_camera("Camera")
+{
+	addLamps(instances < 1 ? 1 : instances);
+	// the cube spans -0.5 to 0.5; the lattice scales it uniformly
+	const float cubeRadius = 0.5f * std::sqrt(3.0f);
+	m_bounds.reserve(m_models.size());
+	for (const auto& model : m_models) {
+		m_bounds.add(glm::vec3(model[3]), cubeRadius * glm::length(glm::vec3(model[0])));
+	}
+}
+
+LightScene::~LightScene()
+{
+	auto& state = GLStateCache::current();
+	glDeleteVertexArrays(1, &m_vao);
+	state.onDeleteVertexArray(m_vao);
+	glDeleteBuffers(1, &m_vbo);
+	state.onDeleteBuffer(m_vbo);
+	glDeleteBuffers(1, &m_ebo);
+	state.onDeleteBuffer(m_ebo);
+	if (m_instanceVbo) {
+		glDeleteBuffers(1, &m_instanceVbo);
+		state.onDeleteBuffer(m_instanceVbo);
+	}
+}
+
+void LightScene::addLamps(int count)
+{
+	const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+	m_lamps.reserve(count);
+	if (count == 1) {
+		// the original lamp
+		m_lamps.push_back(m_transforms.add(TransformHierarchy::NO_PARENT, glm::vec3(1.2f, 1.0f, 2.0f), identity, glm::vec3(0.2f)));
+	} else {
+		// a cubic lattice of side 6 centered on the origin, inside the camera orbit;
+		// every layer is its own subtree, so layers update independently
+		int side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(count))));
+		int layerSize = side * side;
+		float spacing = 6.0f / side;
+		float origin = -0.5f * spacing * (side - 1);
+		auto lattice = m_transforms.add();
+		std::vector<TransformHierarchy::NodeId> layers;
+		for (int z = 0; z * layerSize < count; ++z) {
+			layers.push_back(m_transforms.add(lattice, glm::vec3(0.0f, 0.0f, origin + spacing * z)));
+		}
+		for (int i = 0; i < count; ++i) {
+			glm::vec3 position(origin + spacing * (i % side), origin + spacing * (i / side % side), 0.0f);
+			m_lamps.push_back(m_transforms.add(layers[i / layerSize], position, identity, glm::vec3(0.5f * spacing)));
+		}
+	}
+	m_transforms.update(0);
+	m_models.reserve(m_lamps.size());
+	for (auto lamp : m_lamps) {
+		m_models.push_back(m_transforms.world(lamp));
+	}
+}
+
+bool LightScene::init(float aspectRatio, std::string* log)
+{
+	auto& state = GLStateCache::current();
+	// the 36 corners of the triangle list weld down to the cube's 8
+	auto mesh = Mesh::fromTriangles(s_vertices, s_vertexCount, 3);
+	mesh.printStats();
+	m_indexCount = mesh.indexCount();
+	m_indexType = mesh.indexType();
+
+	glGenBuffers(1, &m_vbo);
+	state.bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices().size() * sizeof(float), mesh.vertices().data(), GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &m_vao);
+	state.bindVertexArray(m_vao);
+	// the element buffer binding is part of the VAO
+	glGenBuffers(1, &m_ebo);
+	state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexDataSize(), mesh.indexData(), GL_STATIC_DRAW);
+	// 只需要绑定VBO不用再次设置VBO的数据，因为箱子的VBO数据中已经包含了正确的立方体顶点数据
+	state.bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	// 设置灯立方体的顶点属性（对我们的灯来说仅仅只有位置数据）
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, mesh.stride(), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	if (!m_shader.attachShaderFile(GL_VERTEX_SHADER, SAMPLE_ASSET_DIR "/Light.vert", log)
+		|| !m_shader.attachShaderFile(GL_FRAGMENT_SHADER, SAMPLE_ASSET_DIR "/Light.frag", log)
+		|| !m_shader.compile(log)) {
+		return false;
+	}
+	m_shader.setUniform("objectColor", glm::vec3(1.0f, 0.5f, 0.31f));
+	m_shader.setUniform("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
+	m_shader.setUniform("model", m_models.front());
+	if ((m_mode == DrawMode::Instanced || m_mode == DrawMode::Streamed) && !initInstancing(log)) {
+		return false;
+	}
+	if (m_mode == DrawMode::GpuDriven && !initGpuDriven(log)) {
+		return false;
+	}
+
+	m_camera.data().projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
+	m_camera.data().view = orbitView(0.0f);
+	return true;
+}
+
+bool LightScene::initInstancing(std::string* log)
+{
+	auto& state = GLStateCache::current();
+	const GLsizeiptr size = m_models.size() * sizeof(glm::mat4);
+	if (m_mode == DrawMode::Streamed) {
+		m_instanceStream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, size);
+		// draw() points the attributes at each frame's region; until then, the first
+		bindInstanceAttributes(m_instanceStream->buffer(), 0);
+	} else {
+		glGenBuffers(1, &m_instanceVbo);
+		state.bindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+		glBufferData(GL_ARRAY_BUFFER, size, m_models.data(), GL_STATIC_DRAW);
+		bindInstanceAttributes(m_instanceVbo, 0);
+	}
+	state.bindVertexArray(m_vao);
+	for (GLuint column = 0; column < 4; ++column) {
+		glEnableVertexAttribArray(1 + column);
+		glVertexAttribDivisor(1 + column, 1);
+	}
+
+	auto vertexSource = ShaderSourceCache::shared().load(SAMPLE_ASSET_DIR "/Light.vert", log);
+	if (!vertexSource
+		|| !m_instancedShader.attachShaderSource(GL_VERTEX_SHADER, ShaderVariantCache::injectDefines(vertexSource, { "INSTANCED" }), log)
+		|| !m_instancedShader.attachShaderFile(GL_FRAGMENT_SHADER, SAMPLE_ASSET_DIR "/Light.frag", log)
+		|| !m_instancedShader.compile(log)) {
+		return false;
+	}
+	m_instancedShader.setUniform("objectColor", glm::vec3(1.0f, 0.5f, 0.31f));
+	m_instancedShader.setUniform("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
+	return true;
+}
+
+bool LightScene::initGpuDriven(std::string* log)
+{
+	if (!GpuCuller::isSupported()) {
+		std::string message = "gpu-driven drawing needs GL 4.3 !";
+		if (log) {
+			*log = message;
+		} else {
+			std::cout << message << "\n";
+		}
+		return false;
+	}
+	m_culler = std::make_unique<GpuCuller>();
+	if (!m_culler->init(SAMPLE_ASSET_DIR "/LightCull.comp", log)) {
+		return false;
+	}
+	std::vector<GpuObject> objects(m_models.size());
+	for (size_t i = 0; i < m_models.size(); ++i) {
+		const auto& model = m_models[i];
+		objects[i].model = model;
+		objects[i].bounds = glm::vec4(glm::vec3(model[3]), m_bounds.radius()[i]);
+		objects[i].indexCount = static_cast<GLuint>(m_indexCount);
+	}
+	m_culler->setObjects(objects);
+	m_culler->bindObjectIds(m_vao, 1);
+
+	if (!m_indirectShader.attachShaderFile(GL_VERTEX_SHADER, SAMPLE_ASSET_DIR "/LightIndirect.vert", log)
+		|| !m_indirectShader.attachShaderFile(GL_FRAGMENT_SHADER, SAMPLE_ASSET_DIR "/Light.frag", log)
+		|| !m_indirectShader.compile(log)) {
+		return false;
+	}
+	m_indirectShader.setUniform("objectColor", glm::vec3(1.0f, 0.5f, 0.31f));
+	m_indirectShader.setUniform("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
+	return true;
+}
+
+void LightScene::bindInstanceAttributes(GLuint buffer, GLintptr offset)
+{
+	// a mat4 attribute takes four locations, one per column, advancing once per instance
+	auto& state = GLStateCache::current();
+	state.bindVertexArray(m_vao);
+	state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint column = 0; column < 4; ++column) {
+		glVertexAttribPointer(1 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+	}
+}
+
+glm::mat4 LightScene::orbitView(float angle)
+{
+	float radius = 10.0f;
+	float camX = std::sin(angle) * radius;
+	float camZ = std::cos(angle) * radius;
+	return glm::lookAt(glm::vec3(camX, 0.0, camZ), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
+}
+
+Shader& LightScene::drawShader()
+{
+	switch (m_mode) {
+	case DrawMode::Instanced:
+	case DrawMode::Streamed:
+		return m_instancedShader;
+	case DrawMode::GpuDriven:
+		return m_indirectShader;
+	default:
+		return m_shader;
+	}
+}
+
+std::vector<Shader*> LightScene::shaders()
+{
+	std::vector<Shader*> result = { &m_shader };
+	if (&drawShader() != &m_shader) {
+		result.push_back(&drawShader());
+	}
+	if (m_culler) {
+		result.push_back(&m_culler->cullShader());
+	}
+	return result;
+}
+
+void LightScene::setView(const glm::mat4& view)
+{
+	m_camera.data().view = view;
+}
+
+void LightScene::prewarm()
+{
+	// with the Camera block backed, as the real draws will have it
+	m_camera.upload();
+	if (m_culler) {
+		// compiles the cull program and binds the objects the vertex shader reads
+		m_culler->cull(m_camera.data().projection * m_camera.data().view);
+	}
+	ShaderPrewarmer prewarmer;
+	prewarmer.add(drawShader(), m_vao);
+	prewarmer.run();
+	prewarmer.printReport();
+}
+
+void LightScene::draw()
+{
+	m_camera.upload();
+	if (m_culler) {
+		m_culler->cull(m_camera.data().projection * m_camera.data().view);
+	}
+	if (m_instanceStream) {
+		// rewritten every frame as if the cubes moved; a full region skips the frame
+		m_instanceStream->beginFrame();
+		auto allocation = m_instanceStream->allocate(m_models.size() * sizeof(glm::mat4));
+		if (allocation.data) {
+			memcpy(allocation.data, m_models.data(), allocation.size);
+		}
+		m_instanceStream->endFrame();
+		if (!allocation.data) {
+			return;
+		}
+		bindInstanceAttributes(m_instanceStream->buffer(), allocation.offset);
+	}
+	auto& shader = drawShader();
+	// uniforms are prepared before binding; on 3.3 contexts flush() binds to edit
+	shader.flush();
+	shader.use();
+	GLStateCache::current().bindVertexArray(m_vao);
+	if (m_culler) {
+		m_culler->draw(GL_TRIANGLES, m_indexType);
+		return;
+	}
+	if (m_mode != DrawMode::PerObject) {
+		glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, m_indexType, nullptr, static_cast<GLsizei>(m_models.size()));
+		return;
+	}
+	const auto& view = m_camera.data().view;
+	m_frustumCuller.cull(Frustum(m_camera.data().projection * view), m_bounds, m_visible);
+	m_queue.clear();
+	for (auto index : m_visible) {
+		RenderItem item;
+		item.shader = &m_shader;
+		item.model = &m_models[index];
+		item.vertexArray = m_vao;
+		item.count = m_indexCount;
+		item.indexType = m_indexType;
+		// view distance over the far plane of the projection
+		float depth = -(view * m_models[index][3]).z / 100.0f;
+		m_queue.submit(0, item, depth);
+	}
+	m_queue.sort();
+	m_queue.execute();
+}
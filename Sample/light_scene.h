@@ -0,0 +1,97 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "frustum_culling.h"
+#include "gpu_culling.h"
+#include "render_queue.h"
+#include "sample_context.h"
+#include "shader.h"
+#include "stream_buffer.h"
+#include "transform_hierarchy.h"
+#include "uniform_block.h"
+
+// matches the Camera block in Light.vert
+struct CameraData {
+	glm::mat4 view;
+	glm::mat4 projection;
+};
+STD140_CHECK(CameraData, view);
+STD140_CHECK(CameraData, projection);
+
+// The lamp cubes drawn by LightSample and LightBench. Construct with the context
+// current and the shader caches installed; init() loads the shaders.
+// A single cube is the original lamp; more are laid out on a lattice around the
+// origin, placed through a TransformHierarchy. Per object, each cube is its own
+// draw with a model uniform, the baseline the other modes are measured against;
+// the cubes outside the view are culled on the CPU by a FrustumCuller first and
+// the rest go through a RenderQueue, which orders them front to back. Instanced
+// scenes draw every cube with one glDrawElementsInstanced, reading the model
+// matrices from a per-instance vertex buffer (Light.vert built with INSTANCED);
+// streamed scenes rewrite that buffer every frame through a StreamBuffer.
+// GPU-driven scenes keep the cubes in a GpuCuller, which culls them in
+// LightCull.comp and draws the visible ones with LightIndirect.vert in one
+// multi-draw; they need GL 4.3.
+class LightScene {
+public:
+	explicit LightScene(int instances = 1, DrawMode mode = DrawMode::PerObject);
+	~LightScene();
+	LightScene(const LightScene&) = delete;
+	LightScene& operator=(const LightScene&) = delete;
+
+	bool init(float aspectRatio, std::string* log = nullptr);
+
+	// Camera on a circle of radius 10 around the origin, looking at it.
+	static glm::mat4 orbitView(float angle);
+	void setView(const glm::mat4& view);
+
+	// Draws once offscreen so the driver finishes compiling before the first frame.
+	void prewarm();
+	void draw();
+
+	// The per-object shader, loaded from files and watched by ShaderReloader.
+	Shader& shader() { return m_shader; }
+	// The shader draw() uses.
+	Shader& drawShader();
+	// Every program the scene built, including the GPU culling one.
+	std::vector<Shader*> shaders();
+	GLuint vertexArray() const { return m_vao; }
+	int instances() const { return static_cast<int>(m_models.size()); }
+	DrawMode drawMode() const { return m_mode; }
+	// nullptr unless the scene is streamed
+	const StreamBuffer* instanceStream() const { return m_instanceStream.get(); }
+	// nullptr unless the scene is GPU-driven
+	GpuCuller* culler() { return m_culler.get(); }
+	// Cubes drawn by the last per-object draw().
+	size_t visibleCount() const { return m_visible.size(); }
+
+private:
+	void addLamps(int count);
+	bool initInstancing(std::string* log);
+	bool initGpuDriven(std::string* log);
+	void bindInstanceAttributes(GLuint buffer, GLintptr offset);
+
+private:
+	GLuint m_vbo = 0;
+	GLuint m_ebo = 0;
+	GLuint m_instanceVbo = 0;
+	GLuint m_vao = 0;
+	GLsizei m_indexCount = 0;
+	GLenum m_indexType = GL_UNSIGNED_SHORT;
+	TransformHierarchy m_transforms;
+	std::vector<TransformHierarchy::NodeId> m_lamps;
+	std::vector<glm::mat4> m_models;	// world matrices of m_lamps
+	SphereBounds m_bounds;
+	FrustumCuller m_frustumCuller;
+	std::vector<uint32_t> m_visible;
+	RenderQueue m_queue;
+	DrawMode m_mode;
+	std::unique_ptr<StreamBuffer> m_instanceStream;
+	std::unique_ptr<GpuCuller> m_culler;
+	UniformBlock<CameraData> m_camera;
+	Shader m_shader;
+	Shader m_instancedShader;
+	Shader m_indirectShader;
+};
@@ -0,0 +1,230 @@
+#include "sample_context.h"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+void reportError(std::string* log, const std::string& message)
+{
+	if (log) {
+		*log = message;
+	} else {
+		std::cout << message << "\n";
+	}
+}
+
+struct ContextVersion {
+	int major;
+	int minor;
+};
+
+// Newest first: the renderer checks the version it got at runtime and uses what
+// it can, so the newest context the driver has is asked for.
+const ContextVersion CONTEXT_VERSIONS[] = {
+	{ 4, 6 }, { 4, 5 }, { 4, 4 }, { 4, 3 }, { 4, 2 }, { 4, 1 }, { 4, 0 }, { 3, 3 },
+};
+
+// --gpu-driven needs compute shaders and indirect draws; --stream-instances falls
+// back to glBufferSubData below 4.4 and the other modes need nothing past 3.3.
+bool supportsDrawMode(const ContextVersion& version, DrawMode mode)
+{
+	return mode != DrawMode::GpuDriven || version.major > 4 || (version.major == 4 && version.minor >= 3);
+}
+
+void printGlfwError(int, const char* description)
+{
+	fprintf(stderr, "Error: %s\n", description);
+}
+
+}
+
+const char* drawModeName(DrawMode mode)
+{
+	switch (mode) {
+	case DrawMode::PerObject: return "per-object";
+	case DrawMode::Instanced: return "instanced";
+	case DrawMode::Streamed: return "streamed";
+	case DrawMode::GpuDriven: return "gpu-driven";
+	}
+	return "unknown";
+}
+
+bool parseSampleOption(int argc, char** argv, int& i, SampleOptions& options)
+{
+	if (!strcmp(argv[i], "--headless")) {
+		options.headless = true;
+		return true;
+	}
+	if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+		++i;
+		return sscanf(argv[i], "%dx%d", &options.width, &options.height) == 2
+			&& options.width > 0 && options.height > 0;
+	}
+	if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+		options.frames = atoi(argv[++i]);
+		return options.frames >= 0;
+	}
+	if (!strcmp(argv[i], "--instances") && i + 1 < argc) {
+		options.instances = atoi(argv[++i]);
+		return options.instances >= 1 && options.instances <= 1000000;
+	}
+	if (!strcmp(argv[i], "--instanced")) {
+		options.drawMode = DrawMode::Instanced;
+		return true;
+	}
+	if (!strcmp(argv[i], "--stream-instances")) {
+		options.drawMode = DrawMode::Streamed;
+		return true;
+	}
+	if (!strcmp(argv[i], "--gpu-driven")) {
+		options.drawMode = DrawMode::GpuDriven;
+		return true;
+	}
+	return false;
+}
+
+SampleContext::~SampleContext()
+{
+	// the render target belongs to the context that is about to go away
+	m_target.reset();
+	if (m_window) {
+		glfwTerminate();
+	}
+}
+
+bool SampleContext::create(const SampleOptions& options, std::string* log)
+{
+	m_options = options;
+	std::vector<ContextVersion> versions;
+	for (const auto& version : CONTEXT_VERSIONS) {
+		if (supportsDrawMode(version, options.drawMode)) {
+			versions.push_back(version);
+		}
+	}
+	if (options.headless) {
+		bool created = false;
+		std::string ignored;
+		for (const auto& version : versions) {
+			// only the last attempt says why it failed
+			created = m_headless.create(version.major, version.minor, &version == &versions.back() ? log : &ignored);
+			if (created) {
+				m_majorVersion = version.major;
+				m_minorVersion = version.minor;
+				break;
+			}
+		}
+		if (!created || !m_headless.makeCurrent()) {
+			return false;
+		}
+		if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::procAddress)) {
+			reportError(log, "Failed to initialize GLAD");
+			return false;
+		}
+		m_target = std::make_unique<RenderTarget>(options.width, options.height);
+		if (!m_target->isComplete()) {
+			reportError(log, "offscreen framebuffer incomplete");
+			return false;
+		}
+		m_target->bind();
+		return true;
+	}
+
+	if (glfwInit() != GLFW_TRUE) {
+		reportError(log, "initialize glfw failed!");
+		return false;
+	}
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_COMPAT_PROFILE, GL_TRUE);
+#endif
+	for (const auto& version : versions) {
+		// only the last attempt says why it failed
+		glfwSetErrorCallback(&version == &versions.back() ? printGlfwError : nullptr);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version.major);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version.minor);
+		m_window = glfwCreateWindow(options.width, options.height, "OpenGLSample", nullptr, nullptr);
+		if (m_window) {
+			break;
+		}
+	}
+	glfwSetErrorCallback(printGlfwError);
+	if (!m_window) {
+		glfwTerminate();
+		reportError(log, "create window failed!");
+		return false;
+	}
+	glfwMakeContextCurrent(m_window);
+	glfwSwapInterval(options.vsync ? 1 : 0);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		reportError(log, "Failed to initialize GLAD");
+		return false;
+	}
+	return true;
+}
+
+bool SampleContext::shouldClose() const
+{
+	return m_window && glfwWindowShouldClose(m_window);
+}
+
+void SampleContext::pollEvents()
+{
+	if (m_window) {
+		glfwPollEvents();
+	}
+}
+
+void SampleContext::present()
+{
+	if (m_window) {
+		glfwSwapBuffers(m_window);
+	}
+}
+
+void SampleContext::framebufferSize(int& width, int& height) const
+{
+	width = m_options.width;
+	height = m_options.height;
+	if (m_window) {
+		glfwGetFramebufferSize(m_window, &width, &height);
+	}
+}
+
+float SampleContext::aspectRatio() const
+{
+	int width, height;
+	framebufferSize(width, height);
+	return height > 0 ? (float)width / (float)height : 1.0f;
+}
+
+ShaderReloader::WorkerContext SampleContext::createWorkerContext()
+{
+	if (m_options.headless) {
+		m_headlessWorker.create(m_majorVersion, m_minorVersion, nullptr, &m_headless);
+		auto worker = &m_headlessWorker;
+		return {
+			[worker]() { return worker->isValid() && worker->makeCurrent(); },
+			[worker]() { worker->doneCurrent(); }
+		};
+	}
+	// hidden window whose context shares objects with the main one; the version
+	// hints are still those the main window was created with
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_workerWindow = glfwCreateWindow(1, 1, "", nullptr, m_window);
+	auto worker = m_workerWindow;
+	return {
+		[worker]() {
+			if (!worker) {
+				return false;
+			}
+			glfwMakeContextCurrent(worker);
+			return true;
+		},
+		[]() { glfwMakeContextCurrent(nullptr); }
+	};
+}
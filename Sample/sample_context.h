@@ -0,0 +1,70 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "headless_context.h"
+#include "render_target.h"
+#include "shader_reloader.h"
+
+struct GLFWwindow;
+
+// How LightScene submits its cubes.
+enum class DrawMode {
+	PerObject,	// a draw and a model uniform per cube
+	Instanced,	// one instanced draw over a static instance buffer
+	Streamed,	// instanced, with the instance data rewritten every frame
+	GpuDriven,	// culled by a compute shader, drawn with one multi-draw indirect
+};
+
+const char* drawModeName(DrawMode mode);
+
+struct SampleOptions {
+	bool headless = false;
+	int width = 1024;
+	int height = 768;
+	int frames = 0;	// 0 runs until the window is closed
+	bool vsync = true;
+	int instances = 1;	// lamp cubes in the scene, 1 to 1M
+	DrawMode drawMode = DrawMode::PerObject;
+};
+
+// Consumes the option at argv[i] (and its value) if it is one of --headless,
+// --size WxH, --frames N, --instances N, --instanced, --stream-instances or
+// --gpu-driven. Returns false for anything else.
+bool parseSampleOption(int argc, char** argv, int& i, SampleOptions& options);
+
+// The GL context a sample renders with: a GLFW window, or a headless EGL context
+// drawing into an offscreen RenderTarget. Must outlive every GL object.
+class SampleContext {
+public:
+	SampleContext() = default;
+	~SampleContext();
+	SampleContext(const SampleContext&) = delete;
+	SampleContext& operator=(const SampleContext&) = delete;
+
+	// Creates the newest core context up to 4.6 the draw mode runs on (3.3, or 4.3
+	// for --gpu-driven), makes it current and loads GL.
+	bool create(const SampleOptions& options, std::string* log = nullptr);
+
+	bool isHeadless() const { return m_options.headless; }
+	bool shouldClose() const;
+	void pollEvents();
+	// Ends the frame: swaps the window; headless frames stay in the render target.
+	void present();
+	void framebufferSize(int& width, int& height) const;
+	float aspectRatio() const;
+	RenderTarget* renderTarget() { return m_target.get(); }
+
+	// Creates a context sharing objects with this one and returns the callbacks that
+	// make it current on a ShaderReloader worker thread and release it there.
+	ShaderReloader::WorkerContext createWorkerContext();
+
+private:
+	SampleOptions m_options;
+	HeadlessContext m_headless;
+	HeadlessContext m_headlessWorker;
+	int m_majorVersion = 3;	// of the headless context
+	int m_minorVersion = 3;
+	GLFWwindow* m_window = nullptr;
+	GLFWwindow* m_workerWindow = nullptr;
+	std::unique_ptr<RenderTarget> m_target;
+};
@@ -0,0 +1,104 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "frustum_culling.h"
+
+// Microbenchmark of FrustumCuller. Culls a fixed pseudo-random set of spheres with
+// every kernel the CPU supports, on one thread and, for sets of at least
+// FrustumCuller::PARALLEL_THRESHOLD, on every hardware thread (or --threads N),
+// and reports objects per nanosecond. Every result is checked against the scalar
+// kernel's.
+
+namespace {
+
+// repeats a run until it took this long, so small sets are timed accurately
+const double MIN_SECONDS = 0.25;
+
+struct Result {
+	double nsPerCull = 0.0;
+	std::vector<uint32_t> visible;
+};
+
+Result measure(const FrustumCuller& culler, const Frustum& frustum, const SphereBounds& bounds)
+{
+	Result result;
+	culler.cull(frustum, bounds, result.visible);
+	int runs = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0.0;
+	do {
+		culler.cull(frustum, bounds, result.visible);
+		++runs;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	result.nsPerCull = elapsed * 1.0e9 / runs;
+	return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<size_t> counts = { 1000, 100000, 1000000 };
+	unsigned parallelThreads = 0;	// every hardware thread
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+			counts = { static_cast<size_t>(atol(argv[++i])) };
+		} else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			parallelThreads = static_cast<unsigned>(atoi(argv[++i]));
+		} else {
+			printf("usage: %s [--count N] [--threads N]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	// the LightSample projection, looking at a cube of spheres from outside
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 40.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(projection * view);
+
+	const CullKernel kernels[] = { CullKernel::Scalar, CullKernel::SSE2, CullKernel::AVX2 };
+	bool mismatch = false;
+	printf("%10s %8s %8s %10s %12s %12s\n", "objects", "kernel", "threads", "visible", "us/cull", "objects/ns");
+	for (auto count : counts) {
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+		std::uniform_real_distribution<float> radius(0.1f, 1.0f);
+		SphereBounds bounds;
+		bounds.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds.add(glm::vec3(position(random), position(random), position(random)), radius(random));
+		}
+
+		std::vector<uint32_t> reference;
+		FrustumCuller(CullKernel::Scalar, 1).cull(frustum, bounds, reference);
+		for (auto kernel : kernels) {
+			if (!FrustumCuller::isSupported(kernel)) {
+				continue;
+			}
+			FrustumCuller culler(kernel, parallelThreads);
+			std::vector<unsigned> threadCounts = { 1 };
+			if (count >= FrustumCuller::PARALLEL_THRESHOLD && culler.threads() > 1) {
+				threadCounts.push_back(culler.threads());
+			}
+			for (auto threads : threadCounts) {
+				culler.setThreads(threads);
+				auto result = measure(culler, frustum, bounds);
+				if (result.visible != reference) {
+					mismatch = true;
+					printf("%s kernel on %u threads disagrees with the scalar kernel\n", cullKernelName(kernel), threads);
+				}
+				printf("%10zu %8s %8u %10zu %12.3f %12.3f\n", count, cullKernelName(kernel), threads,
+					result.visible.size(), result.nsPerCull / 1000.0, count / result.nsPerCull);
+			}
+		}
+	}
+	return mismatch ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gl_state_cache.h"
+#include "headless_context.h"
+#include "light_scene.h"
+#include "sample_context.h"
+
+// Deterministic benchmark of the LightSample scene. A fixed number of warmup and
+// measured frames is rendered with the camera orbit driven by the frame index, and
+// every measured frame records:
+//   cpu     - wall time from the start of the frame until the draws are submitted
+//   gpu     - GL_TIME_ELAPSED around the frame's commands
+//   present - swap (windowed) plus glFinish, so frames never overlap
+//   frame   - cpu + present
+// The summary (mean/p50/p95/p99/max per series) is printed and written as JSON,
+// to be compared against a stored baseline.
+
+namespace {
+
+// one full orbit every 240 frames
+const float ORBIT_STEP = 2.0f * 3.14159265f / 240.0f;
+
+struct Summary {
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+Summary summarize(std::vector<double> values)
+{
+	Summary summary;
+	if (values.empty()) {
+		return summary;
+	}
+	std::sort(values.begin(), values.end());
+	double sum = 0.0;
+	for (auto value : values) {
+		sum += value;
+	}
+	// nearest-rank percentiles
+	auto percentile = [&values](double p) {
+		auto rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+		return values[std::max<size_t>(rank, 1) - 1];
+	};
+	summary.mean = sum / values.size();
+	summary.p50 = percentile(50.0);
+	summary.p95 = percentile(95.0);
+	summary.p99 = percentile(99.0);
+	summary.max = values.back();
+	return summary;
+}
+
+std::string jsonString(const char* str)
+{
+	std::string result = "\"";
+	for (; str && *str; ++str) {
+		if (*str == '"' || *str == '\\') {
+			result += '\\';
+		}
+		result += *str;
+	}
+	return result + "\"";
+}
+
+void writeSummary(std::ostream& out, const char* name, const Summary& summary, bool last = false)
+{
+	out << "  \"" << name << "\": {\"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+		<< ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+		<< ", \"max\": " << summary.max << "}" << (last ? "\n" : ",\n");
+}
+
+double millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	SampleOptions options;
+	options.headless = HeadlessContext::isAvailable();
+	options.vsync = false;
+	int warmupFrames = 60;
+	std::string output = "light_bench.json";
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--window")) {
+			options.headless = false;
+		} else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+			warmupFrames = std::max(0, atoi(argv[++i]));
+		} else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+			output = argv[++i];
+		} else if (!parseSampleOption(argc, argv, i, options)) {
+			printf("usage: %s [--headless | --window] [--size WxH] [--warmup N] [--frames N] [--instances N] [--instanced | --stream-instances | --gpu-driven] [--output file.json]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (options.frames <= 0) {
+		options.frames = 600;
+	}
+
+	SampleContext context;
+	std::string errorLog;
+	if (!context.create(options, &errorLog)) {
+		printf("create context failed: %s\n", errorLog.c_str());
+		return -1;
+	}
+	auto& state = GLStateCache::current();
+	state.enable(GL_DEPTH_TEST);
+
+	LightScene scene(options.instances, options.drawMode);
+	if (!scene.init(context.aspectRatio(), &errorLog)) {
+		printf("load scene failed: %s\n", errorLog.c_str());
+		return -1;
+	}
+	scene.prewarm();
+
+	const int measuredFrames = options.frames;
+	std::vector<GLuint> queries(measuredFrames);
+	glGenQueries(measuredFrames, queries.data());
+	std::vector<double> cpuMs, presentMs, frameMs, gpuMs;
+	cpuMs.reserve(measuredFrames);
+	presentMs.reserve(measuredFrames);
+	frameMs.reserve(measuredFrames);
+
+	for (int frame = 0; frame < warmupFrames + measuredFrames && !context.shouldClose(); ++frame) {
+		bool measured = frame >= warmupFrames;
+		auto frameStart = std::chrono::steady_clock::now();
+		context.pollEvents();
+		if (measured) {
+			glBeginQuery(GL_TIME_ELAPSED, queries[frame - warmupFrames]);
+		}
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		scene.setView(LightScene::orbitView(frame * ORBIT_STEP));
+		scene.draw();
+		if (measured) {
+			glEndQuery(GL_TIME_ELAPSED);
+		}
+		auto submitted = std::chrono::steady_clock::now();
+		context.present();
+		glFinish();
+		auto finished = std::chrono::steady_clock::now();
+		if (measured) {
+			cpuMs.push_back(millisecondsBetween(frameStart, submitted));
+			presentMs.push_back(millisecondsBetween(submitted, finished));
+			frameMs.push_back(millisecondsBetween(frameStart, finished));
+		}
+	}
+	// every frame ended with glFinish, so no result is still pending
+	for (size_t i = 0; i < frameMs.size(); ++i) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+		gpuMs.push_back(elapsed / 1.0e6);
+	}
+	glDeleteQueries(measuredFrames, queries.data());
+
+	std::ostringstream json;
+	json << "{\n"
+		<< "  \"benchmark\": \"LightBench\",\n"
+		<< "  \"renderer\": " << jsonString(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << ",\n"
+		<< "  \"version\": " << jsonString(reinterpret_cast<const char*>(glGetString(GL_VERSION))) << ",\n"
+		<< "  \"headless\": " << (context.isHeadless() ? "true" : "false") << ",\n"
+		<< "  \"width\": " << options.width << ",\n"
+		<< "  \"height\": " << options.height << ",\n"
+		<< "  \"instances\": " << scene.instances() << ",\n"
+		<< "  \"drawMode\": " << jsonString(drawModeName(scene.drawMode())) << ",\n"
+		<< "  \"warmupFrames\": " << warmupFrames << ",\n"
+		<< "  \"frames\": " << frameMs.size() << ",\n";
+	writeSummary(json, "cpuMs", summarize(cpuMs));
+	writeSummary(json, "gpuMs", summarize(gpuMs));
+	writeSummary(json, "presentMs", summarize(presentMs));
+	writeSummary(json, "frameMs", summarize(frameMs), true);
+	json << "}\n";
+
+	printf("%s", json.str().c_str());
+	std::ofstream fout(output, std::ios::trunc);
+	if (!fout || !(fout << json.str())) {
+		printf("write %s failed\n", output.c_str());
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "render_queue.h"
+
+// Microbenchmark of RenderQueue. Submits a pseudo-random scene of draws over
+// --programs, --textures and --vertex-arrays states, spread over three opaque
+// passes and, one draw in TRANSPARENT_SHARE, a transparent one. Sorts the keys with
+// the radix sort and with std::sort for reference, and reports the state changes
+// executing the draws takes in submission order and in key order. No GL context is
+// needed; the state names are made up. The radix sort is checked against
+// std::stable_sort.
+
+namespace {
+
+// repeats a sort until the runs took this long
+const double MIN_SECONDS = 0.5;
+const uint32_t OPAQUE_PASSES = 3;
+const uint32_t TRANSPARENT_PASS = OPAQUE_PASSES;
+const uint32_t TRANSPARENT_SHARE = 16;
+
+template <typename Sort>
+double measure(const std::vector<RenderQueueEntry>& unsorted, std::vector<RenderQueueEntry>& sorted, Sort sort)
+{
+	int runs = 0;
+	double elapsed = 0.0;
+	do {
+		sorted = unsorted;
+		auto start = std::chrono::steady_clock::now();
+		sort(sorted);
+		elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		++runs;
+	} while (elapsed < MIN_SECONDS);
+	return elapsed * 1000.0 / runs;
+}
+
+void printChanges(const char* order, const RenderQueueStats& stats)
+{
+	printf("%-12s %10u %10u %10u %10u\n", order, stats.programChanges, stats.textureChanges,
+		stats.vertexArrayChanges, stats.total());
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = 1000000;
+	uint32_t programs = 64;
+	uint32_t textures = 256;
+	uint32_t vertexArrays = 32;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+			count = static_cast<size_t>(atol(argv[++i]));
+		} else if (!strcmp(argv[i], "--programs") && i + 1 < argc) {
+			programs = static_cast<uint32_t>(atoi(argv[++i]));
+		} else if (!strcmp(argv[i], "--textures") && i + 1 < argc) {
+			textures = static_cast<uint32_t>(atoi(argv[++i]));
+		} else if (!strcmp(argv[i], "--vertex-arrays") && i + 1 < argc) {
+			vertexArrays = static_cast<uint32_t>(atoi(argv[++i]));
+		} else {
+			printf("usage: %s [--count N] [--programs N] [--textures N] [--vertex-arrays N]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (!count || !programs || !textures || !vertexArrays) {
+		printf("counts must be positive\n");
+		return -1;
+	}
+
+	std::mt19937 random(1);
+	std::uniform_int_distribution<uint32_t> share(0, TRANSPARENT_SHARE - 1);
+	std::uniform_int_distribution<uint32_t> opaquePass(0, OPAQUE_PASSES - 1);
+	std::uniform_int_distribution<GLuint> program(1, programs);
+	std::uniform_int_distribution<GLuint> texture(1, textures);
+	std::uniform_int_distribution<GLuint> vertexArray(1, vertexArrays);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+	RenderQueue queue;
+	queue.setTransparent(TRANSPARENT_PASS, true);
+	queue.reserve(count);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i) {
+		RenderItem item;
+		item.program = program(random);
+		item.texture = texture(random);
+		item.vertexArray = vertexArray(random);
+		item.count = 36;
+		uint32_t pass = share(random) == 0 ? TRANSPARENT_PASS : opaquePass(random);
+		queue.submit(pass, item, depth(random));
+	}
+	double submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu draws submitted in %.2f ms\n", count, submitMs);
+
+	const auto& unsorted = queue.entries();
+	std::vector<RenderQueueEntry> sorted;
+	std::vector<RenderQueueEntry> scratch;
+	double radixMs = measure(unsorted, sorted, [&scratch](std::vector<RenderQueueEntry>& entries) {
+		RenderQueue::radixSort(entries, scratch);
+	});
+	std::vector<RenderQueueEntry> reference;
+	double stdMs = measure(unsorted, reference, [](std::vector<RenderQueueEntry>& entries) {
+		std::sort(entries.begin(), entries.end(), [](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.key < b.key; });
+	});
+	printf("radix sort %.2f ms, std::sort %.2f ms\n", radixMs, stdMs);
+
+	reference = unsorted;
+	std::stable_sort(reference.begin(), reference.end(), [](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.key < b.key; });
+	bool mismatch = !std::equal(sorted.begin(), sorted.end(), reference.begin(), reference.end(),
+		[](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.key == b.key && a.item == b.item; });
+	if (mismatch) {
+		printf("radix sort disagrees with std::stable_sort\n");
+	}
+
+	printf("%-12s %10s %10s %10s %10s\n", "order", "programs", "textures", "vaos", "total");
+	printChanges("submission", queue.stateChanges());
+	queue.sort();
+	printChanges("sorted", queue.stateChanges());
+	return mismatch ? 1 : 0;
+}
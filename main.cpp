@@ -1,155 +1,114 @@
 ﻿#include <glad/glad.h>
-#include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 
+#include <chrono>
 #include <cstdio>
 
-#include "shader.h"
+#include "gl_state_cache.h"
+#include "gpu_profiler.h"
+#include "light_scene.h"
+#include "program_binary_cache.h"
+#include "sample_context.h"
+#include "shader_reloader.h"
+#include "shader_stage_cache.h"
 
 int main(int argc, char** argv)
 {
-    if (glfwInit() != GLFW_TRUE) {
-        printf("initialize glfw failed!");
-        return -1;
+    SampleOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (!parseSampleOption(argc, argv, i, options)) {
+            printf("usage: %s [--headless] [--size WxH] [--frames N] [--instances N] [--instanced | --stream-instances | --gpu-driven]\n", argv[0]);
+            return -1;
+        }
     }
+    // without a window nothing else ends the run
+    if (options.headless && options.frames <= 0) {
+        options.frames = 300;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    auto secondsSinceStart = [startTime]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    };
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwSetErrorCallback([](int error, const char* description) {
-        fprintf(stderr, "Error: %s\n", description);
-    });
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_COMPAT_PROFILE, GL_TRUE);
-#endif
-
-    GLFWwindow* window = glfwCreateWindow(1024, 768, "OpenGLSample", nullptr, nullptr);
-    if (!window) {
-        glfwTerminate();
+    // declared first so it outlives every GL object below
+    SampleContext context;
+    std::string errorLog;
+    if (!context.create(options, &errorLog)) {
+        printf("create context failed: %s\n", errorLog.c_str());
         return -1;
     }
-    glfwMakeContextCurrent(window);
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        printf("Failed to initialize GLAD\n");
+    auto& state = GLStateCache::current();
+    state.enable(GL_DEPTH_TEST);
+
+    ProgramBinaryCache binaryCache("shader_cache");
+    Shader::setBinaryCache(&binaryCache);
+    ShaderStageCache stageCache;
+    Shader::setStageCache(&stageCache);
+    // declared before the shaders so it outlives them; written at exit
+    ShaderTelemetry telemetry("shader_telemetry.json");
+    Shader::setTelemetry(&telemetry);
+    double shaderLoadStart = secondsSinceStart();
+    LightScene scene(options.instances, options.drawMode);
+    if (!scene.init(context.aspectRatio(), &errorLog)) {
+        printf("load scene failed: %s\n", errorLog.c_str());
         return -1;
     }
+    printf("shader load took %.3f ms\n", (secondsSinceStart() - shaderLoadStart) * 1000.0);
+    binaryCache.printStats();
+    stageCache.printStats();
+    ShaderSourceCache::shared().printStats();
 
-    glEnable(GL_COLOR_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
-
-    /////////////////////////
-
-    float vertices[] = {
-        //     ---- 位置 ----
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f,
-    };
-
+    // rebuilds edited shaders in the background on a context sharing objects with this one
+    ShaderReloader reloader(context.createWorkerContext());
+    for (auto shader : scene.shaders())
+        reloader.watch(*shader);
 
-    GLuint VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-
-    unsigned int lightVAO;
-    glGenVertexArrays(1, &lightVAO);
-    glBindVertexArray(lightVAO);
-    // 只需要绑定VBO不用再次设置VBO的数据，因为箱子的VBO数据中已经包含了正确的立方体顶点数据
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // 设置灯立方体的顶点属性（对我们的灯来说仅仅只有位置数据）
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-
-    // 在此之前不要忘记首先 use 对应的着色器程序（来设定uniform）
-    Shader lightingShader;
-    std::string errorLog;
-    if (!lightingShader.attachShaderFile(GL_VERTEX_SHADER, "D:\\workspace\\OpenGLSampleCode\\Light.vert", &errorLog))
-        printf("vertex shader add failed: %s", errorLog.c_str());
-    if (!lightingShader.attachShaderFile(GL_FRAGMENT_SHADER, "D:\\workspace\\OpenGLSampleCode\\Light.frag", &errorLog))
-        printf("fragment shader add failed: %s", errorLog.c_str());
-    if (!lightingShader.compile(&errorLog))
-        printf("compile failed: %s", errorLog.c_str());
-    lightingShader.use();
-    lightingShader.setUniform("objectColor", glm::vec3(1.0f, 0.5f, 0.31f));
-    lightingShader.setUniform("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
-
-    glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
-
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, lightPos);
-    model = glm::scale(model, glm::vec3(0.2f));
-    lightingShader.setUniform("model", model);
-
-    //glm::mat4 view = glm::lookAt(glm::vec3(1, 0.0, 0), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
-
-
-    glm::mat4 projection = glm::mat4(1.0f);
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    projection = glm::perspective(glm::radians(45.0f), (float)(width / height), 0.1f, 100.0f);
-    lightingShader.setUniform("projection", projection);
+    // pay for the driver's deferred code generation now instead of in the first frame
+    scene.prewarm();
+    telemetry.printSummary();
 
     ////////////////////////
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-
-        lightingShader.use();
-        float radius = 10.0f;
-        float camX = sin(glfwGetTime()) * radius;
-        float camZ = cos(glfwGetTime()) * radius;
-        auto view = glm::lookAt(glm::vec3(camX, 0.0, camZ), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
-        lightingShader.setUniform("view", view);
-
-        glBindVertexArray(lightVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glfwSwapBuffers(window);
+    // per-pass GPU times, read back a few frames late so the loop never waits on them
+    GpuProfiler profiler;
+    int frame = 0;
+    double loopStart = secondsSinceStart();
+    while (frame != options.frames && !context.shouldClose()) {
+        context.pollEvents();
+        reloader.applyPending();
+
+        profiler.beginFrame();
+        scene.setView(LightScene::orbitView((float)secondsSinceStart()));
+        {
+            GpuProfiler::Scope zone(profiler, "light");
+            scene.draw();
+        }
+        profiler.endFrame();
+        context.present();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        ++frame;
+    }
+    if (context.isHeadless()) {
+        glFinish();
+        double elapsed = secondsSinceStart() - loopStart;
+        printf("headless: %d frames at %dx%d in %.3f s (%.3f ms/frame)\n",
+            frame, options.width, options.height, elapsed, frame ? elapsed * 1000.0 / frame : 0.0);
     }
+    profiler.printReport();
+    if (scene.instanceStream())
+        scene.instanceStream()->printStats();
+    if (scene.culler())
+        scene.culler()->printStats();
+    if (scene.drawMode() == DrawMode::PerObject)
+        printf("cpu culling: %zu of %d objects drawn in the last frame\n", scene.visibleCount(), scene.instances());
+
+    printf("%d cubes drawn %s\n", scene.instances(), drawModeName(scene.drawMode()));
+    const auto& uniformStats = scene.drawShader().uniformStats();
+    printf("uniform uploads: %llu issued, %llu skipped\n",
+        (unsigned long long)uniformStats.issued, (unsigned long long)uniformStats.skipped());
+    printf("state changes: %llu issued, %llu skipped\n",
+        (unsigned long long)state.stats().issued, (unsigned long long)state.stats().skipped);
 
     return 0;
 }